@@ -0,0 +1,81 @@
+#include "alloc.h"
+
+#ifdef ALLOC_PROFILE
+
+#include <cstdlib>
+#include <new>
+
+/*
+  Global operator new and delete counting into AllocationProfile. Blocks come
+  from malloc with their size in front, padded to keep new's alignment.
+*/
+namespace {
+
+const size_t HEADER_SIZE = alignof(std::max_align_t);
+
+void *allocate(size_t size) {
+  char *block = (char *)malloc(size + HEADER_SIZE);
+  if (!block) {
+    return NULL;
+  }
+  *(size_t *)block = size;
+  AllocationProfile::allocated(size);
+  return block + HEADER_SIZE;
+}
+
+void *allocateOrThrow(size_t size) {
+  for (;;) {
+    void *pointer = allocate(size ? size : 1);
+    if (pointer) {
+      return pointer;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *allocateOrNull(size_t size) noexcept {
+  try {
+    return allocateOrThrow(size);
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void deallocate(void *pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  char *block = (char *)pointer - HEADER_SIZE;
+  AllocationProfile::freed(*(size_t *)block);
+  free(block);
+}
+
+} // namespace
+
+void *operator new(size_t size) { return allocateOrThrow(size); }
+void *operator new[](size_t size) { return allocateOrThrow(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocateOrNull(size);
+}
+
+void operator delete(void *pointer) noexcept { deallocate(pointer); }
+void operator delete[](void *pointer) noexcept { deallocate(pointer); }
+void operator delete(void *pointer, size_t) noexcept { deallocate(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { deallocate(pointer); }
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  deallocate(pointer);
+}
+
+#endif
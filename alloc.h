@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/*
+  Heap allocation profile, compiled in with -DALLOC_PROFILE (make ALLOCS=1).
+
+  alloc.cpp then replaces the global operator new and delete of the binary:
+  every block carries its size in a small header, and allocations, bytes and
+  live bytes are kept in process-wide atomics. ScopedPhase (telemetry.h)
+  reports the allocations and bytes of every phase, nested phases included,
+  along with the peak of live bytes during it.
+
+  Without the flag nothing is replaced and isEnabled() is false.
+*/
+class AllocationProfile {
+  enum { ALLOCATIONS, BYTES, LIVE, PEAK, NO_OF_COUNTERS };
+
+  /* Zero-initialized before any constructor runs, so usable from new */
+  static std::atomic<long long> *counters() {
+    static std::atomic<long long> values[NO_OF_COUNTERS];
+    return values;
+  }
+
+public:
+  struct Totals {
+    long long allocations;
+    long long bytes;
+    long long live;
+  };
+
+  static constexpr bool isEnabled() {
+#ifdef ALLOC_PROFILE
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  static void allocated(size_t size) {
+    std::atomic<long long> *c = counters();
+    c[ALLOCATIONS].fetch_add(1, std::memory_order_relaxed);
+    c[BYTES].fetch_add(size, std::memory_order_relaxed);
+    long long live = c[LIVE].fetch_add(size, std::memory_order_relaxed) + size;
+    long long peak = c[PEAK].load(std::memory_order_relaxed);
+    while (peak < live && !c[PEAK].compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {
+    }
+  }
+
+  static void freed(size_t size) {
+    counters()[LIVE].fetch_sub(size, std::memory_order_relaxed);
+  }
+
+  static Totals read() {
+    std::atomic<long long> *c = counters();
+    return Totals{c[ALLOCATIONS].load(std::memory_order_relaxed),
+                  c[BYTES].load(std::memory_order_relaxed),
+                  c[LIVE].load(std::memory_order_relaxed)};
+  }
+
+  /*
+    Restart the peak from the live bytes; returns the peak so far, which
+    endPeak() needs back. Calls nest like phases.
+  */
+  static long long beginPeak() {
+    std::atomic<long long> *c = counters();
+    return c[PEAK].exchange(c[LIVE].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+  }
+
+  /* Peak since the matching beginPeak(); the outer peak resumes */
+  static long long endPeak(long long outerPeak) {
+    std::atomic<long long> *c = counters();
+    long long peak = c[PEAK].load(std::memory_order_relaxed);
+    long long current = peak;
+    while (current < outerPeak &&
+           !c[PEAK].compare_exchange_weak(current, outerPeak,
+                                          std::memory_order_relaxed)) {
+    }
+    return peak;
+  }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "numa.h"
+
+/*
+  Storage for the vertices, faces or edges of a mesh. Objects are created in
+  place in large chunks that come from Numa::map(), with the huge page hint,
+  and are first touched in parallel by the current OpenMP team before
+  anything is constructed in them (see numa.h). Objects are created in id
+  order, so the chunk of ids a thread touched is the block it later
+  simplifies.
+
+  Objects live as long as the arena: they are never freed one by one, and
+  are destroyed together when the arena is. reserve() ahead of a known count
+  keeps the objects in one chunk; beyond it, create() adds chunks as large
+  as the last one. If the kernel refuses a mapping, the chunk comes from the
+  heap instead and is placed wherever the allocator puts it.
+*/
+template <typename T> class Arena {
+  struct Chunk {
+    T *items;
+    size_t capacity;
+    size_t count;
+    bool mapped;
+  };
+
+  std::vector<Chunk> chunks;
+
+  void add(size_t capacity) {
+    size_t bytes = capacity * sizeof(T);
+    Chunk chunk = {(T *)Numa::map(bytes), capacity, 0, true};
+    if (chunk.items) {
+      Numa::firstTouch(chunk.items, bytes);
+    } else {
+      chunk.items = (T *)::operator new(bytes);
+      chunk.mapped = false;
+    }
+    this->chunks.push_back(chunk);
+  }
+
+public:
+  Arena() {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() { this->clear(); }
+
+  /* Room for <n> more objects in one chunk */
+  void reserve(size_t n) {
+    if (this->chunks.empty() ||
+        this->chunks.back().capacity - this->chunks.back().count < n) {
+      this->add(std::max(n, (size_t)1));
+    }
+  }
+
+  template <typename... Args> T *create(Args &&...args) {
+    if (this->chunks.empty() ||
+        this->chunks.back().count == this->chunks.back().capacity) {
+      this->add(this->chunks.empty() ? 1024 : this->chunks.back().capacity);
+    }
+    Chunk &chunk = this->chunks.back();
+    return new (chunk.items + chunk.count++) T(std::forward<Args>(args)...);
+  }
+
+  /* Destroy every object and release the chunks */
+  void clear() {
+    for (Chunk &chunk : this->chunks) {
+      for (size_t i = 0; i < chunk.count; i++) {
+        chunk.items[i].~T();
+      }
+      if (chunk.mapped) {
+        Numa::unmap(chunk.items, chunk.capacity * sizeof(T));
+      } else {
+        ::operator delete(chunk.items);
+      }
+    }
+    this->chunks.clear();
+  }
+
+  void swap(Arena &arena) { this->chunks.swap(arena.chunks); }
+};
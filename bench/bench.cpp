@@ -0,0 +1,179 @@
+#include <cstring>
+#include <iostream>
+
+#include "../mesh.h"
+#include "../qem.h"
+#include "bench.h"
+#include "synthetic.h"
+
+/*
+  Per-phase microbenchmarks of the top-level engine. Loading, quadrics and
+  edge costs are independent phases; collapses and writing run against one
+  mesh that is simplified further by every iteration.
+*/
+class MeshBenchmarks {
+  static Mesh *parse(const char *inputFile, SpaceFillingCurve::Curve curve) {
+    Mesh *mesh = new Mesh();
+    FILE *file = fopen(inputFile, "r");
+    char buffer[256];
+    if (!file || fscanf(file, "%s\n", buffer) != 1 ||
+        !mesh->readCounts(file)) {
+      std::cerr << std::endl
+                << "Error:  Unable to read " << inputFile << "." << std::endl;
+      exit(11);
+    }
+    mesh->readVertices(file);
+    mesh->readFaces(file);
+    if (curve != SpaceFillingCurve::NONE) {
+      mesh->reorder(curve);
+    }
+    fclose(file);
+    return mesh;
+  }
+
+public:
+  static void run(BenchmarkSuite &suite, const char *inputFile,
+                  SpaceFillingCurve::Curve curve,
+                  const BenchmarkOptions &options) {
+    QuadricErrorMetrics *qem = QuadricErrorMetrics::getInstance();
+    Mesh *mesh = NULL;
+    auto release = [&]() {
+      delete mesh;
+      mesh = NULL;
+    };
+    auto load = [&]() {
+      if (!mesh) {
+        mesh = new Mesh(inputFile, curve);
+        qem->calculateQuadrics(mesh);
+        qem->calculateEdgeCosts(mesh);
+      }
+    };
+
+    suite.run(
+        "off-parse", nullptr,
+        [&]() {
+          mesh = parse(inputFile, curve);
+          return mesh->noOfVertices + mesh->noOfFaces;
+        },
+        release);
+
+    suite.run(
+        "read-edges", [&]() { mesh = parse(inputFile, curve); },
+        [&]() {
+          mesh->readEdges();
+          return mesh->noOfFaces;
+        },
+        release);
+
+    suite.run("quadrics", load, [&]() {
+      qem->calculateQuadrics(mesh);
+      return mesh->noOfVertices;
+    });
+
+    suite.run("edge-costs", load, [&]() {
+      qem->calculateEdgeCosts(mesh);
+      return mesh->noOfEdges;
+    });
+
+    // Batched placement of every edge alone, gathering included, without
+    // writing the results back to the edges
+    Placement batch;
+    for (Placement::Policy policy : {Placement::MIDPOINT, Placement::OPTIMAL}) {
+      std::string name = std::string("solve-") + Placement::getName(policy);
+      suite.run(name.c_str(), load, [&]() {
+        Quadric Q;
+        batch.clear();
+        for (Edge *edge : mesh->edges) {
+          const Vertex *v1 = edge->getV1();
+          const Vertex *v2 = edge->getV2();
+          memcpy(Q, v1->Q, sizeof(Quadric));
+          QuadricErrorMetrics::sumQuadrics(Q, v2->Q);
+          Scalar p1[3] = {v1->getX(), v1->getY(), v1->getZ()};
+          Scalar p2[3] = {v2->getX(), v2->getY(), v2->getZ()};
+          batch.add(Q, p1, p2);
+          if (batch.isFull()) {
+            batch.solve(policy);
+            batch.clear();
+          }
+        }
+        batch.solve(policy);
+        return mesh->noOfEdges;
+      });
+    }
+    release();
+
+    /*
+      Collapse the cheapest edge of vertices visited in a fixed pseudo-random
+      order, sized so the mesh is at most half simplified by the last
+      iteration.
+    */
+    int noOfIterations = options.warmup + options.repetitions;
+    int next = 0;
+    suite.run("collapse-edge", load, [&]() {
+      int noOfVertices = mesh->noOfVertices;
+      int batch = std::min(1000, noOfVertices / (2 * noOfIterations));
+      int collapses = 0;
+      for (int i = 0; collapses < batch && i < noOfVertices; i++) {
+        Vertex *v = mesh->vertices[(next++ * 7919LL) % noOfVertices];
+        if (!v->isRemoved() && v->hasFaces() &&
+            qem->collapseEdge(v->getEdgeWithMinCost())) {
+          collapses++;
+        }
+      }
+      return collapses;
+    });
+
+    suite.run("write", load, [&]() {
+      mesh->write("/dev/null");
+      return (int)mesh->vertices.size() + (int)mesh->faces.size();
+    });
+    release();
+  }
+};
+
+/* Benchmark <inputFile> in file order and along every requested curve */
+static void run(BenchmarkSuite &suite, const std::string &name,
+                const char *inputFile, const BenchmarkOptions &options) {
+  static const char *suffixes[] = {"", "+morton", "+hilbert"};
+  for (SpaceFillingCurve::Curve curve : options.curves) {
+    if (curve != SpaceFillingCurve::NONE) {
+      std::cout << "Reordered along " << suffixes[curve] + 1 << std::endl;
+    }
+    suite.setInput(name + suffixes[curve]);
+    MeshBenchmarks::run(suite, inputFile, curve, options);
+  }
+}
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options(argc, argv, "bench");
+  BenchmarkSuite suite(options.warmup, options.repetitions);
+
+  for (const std::string &input : options.inputs) {
+    std::cout << std::endl << "Benchmarking " << input << std::endl;
+    run(suite, input, input.c_str(), options);
+  }
+
+  for (int n : options.grids) {
+    std::string input = writeSyntheticGrid(n);
+    if (input.empty()) {
+      std::cerr << std::endl
+                << "Error:  Unable to create synthetic mesh." << std::endl;
+      exit(17);
+    }
+    std::cout << std::endl
+              << "Benchmarking grid-" << n << " [" << n * n << " vertex(s)]"
+              << std::endl;
+    run(suite, "grid-" + std::to_string(n), input.c_str(), options);
+    unlink(input.c_str());
+  }
+  if (!suite.save(options.jsonFile.c_str())) {
+    std::cerr << std::endl
+              << "Error:  Unable to create " << options.jsonFile << "."
+              << std::endl;
+    exit(16);
+  }
+  std::cout << std::endl
+            << "Results written to " << options.jsonFile << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include "../sfc.h"
+
+/* Silences std::cout and std::cerr for its lifetime */
+class QuietOutput {
+  std::streambuf *out;
+  std::streambuf *err;
+
+public:
+  QuietOutput() : out(std::cout.rdbuf(NULL)), err(std::cerr.rdbuf(NULL)) {}
+  ~QuietOutput() {
+    std::cout.rdbuf(this->out);
+    std::cout.clear();
+    std::cerr.rdbuf(this->err);
+    std::cerr.clear();
+  }
+};
+
+/*
+  Minimal benchmark harness shared by the engine benchmarks. Each benchmark
+  runs <warmup> untimed and <repetitions> timed iterations of its body; an
+  optional setup runs before every iteration and is not timed. Engine output
+  on std::cout and std::cerr is silenced while a benchmark runs.
+*/
+class BenchmarkSuite {
+public:
+  struct Result {
+    std::string name;
+    std::string input;
+    int ops;                     // operations per iteration
+    std::vector<double> samples; // milliseconds, sorted
+  };
+
+private:
+  int warmup;
+  int repetitions;
+  std::string input;
+  std::vector<Result> results;
+
+  static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+  }
+
+public:
+  BenchmarkSuite() = delete;
+  BenchmarkSuite(int warmup, int repetitions)
+      : warmup(warmup), repetitions(std::max(repetitions, 1)) {}
+
+  /* Name of the mesh the following benchmarks run against */
+  void setInput(const std::string &input) { this->input = input; }
+
+  void run(const char *name, const std::function<void()> &setup,
+           const std::function<int()> &body,
+           const std::function<void()> &teardown = nullptr) {
+    Result result;
+    result.name = name;
+    result.input = this->input;
+    result.ops = 0;
+
+    {
+      QuietOutput quiet;
+      for (int i = 0; i < this->warmup + this->repetitions; i++) {
+        if (setup) {
+          setup();
+        }
+        double t0 = now();
+        result.ops = body();
+        double t1 = now();
+        if (teardown) {
+          teardown();
+        }
+        if (i >= this->warmup) {
+          result.samples.push_back(t1 - t0);
+        }
+      }
+    }
+
+    std::sort(result.samples.begin(), result.samples.end());
+    std::cout << "  " << name;
+    for (int i = strlen(name); i < 16; i++) {
+      std::cout << " ";
+    }
+    std::cout << "median " << percentile(result, 50) << " ms  p90 "
+              << percentile(result, 90) << " ms  [" << result.ops
+              << " op(s)]" << std::endl;
+
+    this->results.push_back(result);
+  }
+
+  /* Nearest-rank percentile of the sorted samples */
+  static double percentile(const Result &result, double p) {
+    int n = result.samples.size();
+    int rank = std::min(n - 1, std::max(0, (int)(p / 100.0 * n + 0.5) - 1));
+    return result.samples[rank];
+  }
+
+  bool save(const char *jsonFile) const {
+    FILE *file = fopen(jsonFile, "w");
+    if (!file) {
+      return false;
+    }
+
+    fprintf(file, "{\n  \"warmup\": %d,\n  \"repetitions\": %d,\n",
+            this->warmup, this->repetitions);
+    fprintf(file, "  \"results\": [\n");
+    for (int i = 0; i < (int)this->results.size(); i++) {
+      const Result &r = this->results[i];
+      double sum = 0.0;
+      for (double s : r.samples) {
+        sum += s;
+      }
+      fprintf(file,
+              "    {\"name\": \"%s\", \"input\": \"%s\", \"ops\": %d, "
+              "\"min_ms\": %f, \"median_ms\": %f, \"mean_ms\": %f, "
+              "\"p90_ms\": %f, \"p99_ms\": %f, \"max_ms\": %f, "
+              "\"samples_ms\": [",
+              r.name.c_str(), r.input.c_str(), r.ops, r.samples.front(),
+              percentile(r, 50), sum / r.samples.size(), percentile(r, 90),
+              percentile(r, 99), r.samples.back());
+      for (int j = 0; j < (int)r.samples.size(); j++) {
+        fprintf(file, "%s%f", j ? ", " : "", r.samples[j]);
+      }
+      fprintf(file, "]}%s\n", i + 1 < (int)this->results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+  }
+};
+
+/*
+  Command line shared by the benchmark binaries:
+    [--warmup N] [--repetitions N] [--json file] [--grid N]...
+    [--reorder curve]... [input.off]...
+  Without inputs, bunny.off and two synthetic grids are used. Every input is
+  run in file order and then once per --reorder curve, where the engine
+  supports it. Results go to <name>.json by default.
+*/
+struct BenchmarkOptions {
+  int warmup = 1;
+  int repetitions = 5;
+  std::string jsonFile;
+  std::vector<std::string> inputs;
+  std::vector<int> grids;
+  std::vector<SpaceFillingCurve::Curve> curves = {SpaceFillingCurve::NONE};
+
+  BenchmarkOptions(int argc, char **argv, const char *name)
+      : jsonFile(std::string(name) + ".json") {
+    SpaceFillingCurve::Curve curve;
+    for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+        this->warmup = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "--repetitions") && i + 1 < argc) {
+        this->repetitions = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+        this->jsonFile = argv[++i];
+      } else if (!strcmp(argv[i], "--grid") && i + 1 < argc) {
+        this->grids.push_back(atoi(argv[++i]));
+      } else if (!strcmp(argv[i], "--reorder") && i + 1 < argc &&
+                 SpaceFillingCurve::parse(argv[i + 1], curve) &&
+                 curve != SpaceFillingCurve::NONE) {
+        this->curves.push_back(curve);
+        i++;
+      } else if (argv[i][0] == '-') {
+        std::cerr << std::endl
+                  << "Usage:  " << name
+                  << " [--warmup <n>] [--repetitions <n>] [--json <file>] "
+                     "[--grid <n>]... [--reorder morton|hilbert]... "
+                     "[input.off]...\n"
+                  << std::endl;
+        exit(1);
+      } else {
+        this->inputs.push_back(argv[i]);
+      }
+    }
+
+    if (this->inputs.empty() && this->grids.empty()) {
+      this->inputs.push_back("bunny.off");
+      this->grids.push_back(64);
+      this->grids.push_back(256);
+    }
+  }
+};
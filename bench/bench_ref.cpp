@@ -0,0 +1,140 @@
+#include <iostream>
+
+#include "../ref/SimpQEM.h"
+#include "../ref/Surface.h"
+#include "bench.h"
+#include "synthetic.h"
+
+/*
+  Per-phase microbenchmarks of the reference engine, mirroring bench.cpp.
+  Built as a separate binary: both engines define Edge and Face.
+*/
+static void runBenchmarks(BenchmarkSuite &suite, const char *inputFile,
+                          const BenchmarkOptions &options) {
+  Surface *s = NULL;
+  SimpQEM *qem = NULL;
+  auto release = [&]() {
+    delete qem;
+    delete s;
+    qem = NULL;
+    s = NULL;
+  };
+  auto load = [&]() {
+    if (!s) {
+      s = new Surface(inputFile);
+      qem = new SimpQEM(s, 1);
+    }
+  };
+
+  suite.run(
+      "off-parse", nullptr,
+      [&]() {
+        load();
+        return (int)(s->m_points.size() + s->m_faces.size());
+      },
+      release);
+
+  suite.run(
+      "quadrics", load,
+      [&]() {
+        qem->initQuadrics();
+        return (int)s->m_points.size();
+      },
+      release);
+
+  // Edges are built and costed in one pass in this engine
+  suite.run(
+      "edge-costs",
+      [&]() {
+        load();
+        qem->initQuadrics();
+      },
+      [&]() {
+        qem->initEdgeCosts();
+        return qem->total_edges;
+      },
+      release);
+
+  /*
+    Pop the global edge queue and collapse, as the serial path of
+    SimpQEM::simplify does, sized so the mesh is at most half simplified by
+    the last iteration.
+  */
+  int noOfIterations = options.warmup + options.repetitions;
+  suite.run(
+      "collapse-edge",
+      [&]() {
+        if (!s) {
+          load();
+          qem->initQuadrics();
+          qem->initEdgeCosts();
+        }
+      },
+      [&]() {
+        int batch =
+            std::min(1000, (int)s->m_points.size() / (2 * noOfIterations));
+        int collapses = 0;
+        while (collapses < batch && !qem->edge_queue.empty()) {
+          Edge e = qem->edge_queue.top();
+          qem->edge_queue.pop();
+          if (s->is_edge_removed[e.id] ||
+              e.cost != qem->currentEdgeCost[e.id] || e.p1->faces.empty() ||
+              e.p2->faces.empty()) {
+            continue;
+          }
+
+          double tempQ[4][4];
+          copyQuadrics(tempQ, e.p1->Q);
+          sumQuadrics(tempQ, e.p2->Q);
+          if (s->collapse(e)) {
+            copyQuadrics(e.p2->Q, tempQ);
+            qem->currentEdgeCost[e.id] = INF;
+            collapses++;
+          }
+        }
+        return collapses;
+      });
+
+  suite.run("write", nullptr, [&]() {
+    s->saveOFF("/dev/null");
+    return (int)(s->m_points.size() + s->m_faces.size());
+  });
+  release();
+}
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options(argc, argv, "bench-ref");
+  BenchmarkSuite suite(options.warmup, options.repetitions);
+
+  for (const std::string &input : options.inputs) {
+    std::cout << std::endl << "Benchmarking " << input << std::endl;
+    suite.setInput(input);
+    runBenchmarks(suite, input.c_str(), options);
+  }
+
+  for (int n : options.grids) {
+    std::string input = writeSyntheticGrid(n);
+    if (input.empty()) {
+      std::cerr << std::endl
+                << "Error:  Unable to create synthetic mesh." << std::endl;
+      exit(17);
+    }
+    std::cout << std::endl
+              << "Benchmarking grid-" << n << " [" << n * n << " vertex(s)]"
+              << std::endl;
+    suite.setInput("grid-" + std::to_string(n));
+    runBenchmarks(suite, input.c_str(), options);
+    unlink(input.c_str());
+  }
+
+  if (!suite.save(options.jsonFile.c_str())) {
+    std::cerr << std::endl
+              << "Error:  Unable to create " << options.jsonFile << "."
+              << std::endl;
+    exit(16);
+  }
+  std::cout << std::endl
+            << "Results written to " << options.jsonFile << std::endl;
+
+  return 0;
+}
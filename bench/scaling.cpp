@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+
+#include "../mesh.h"
+#include "../qem.h"
+#include "scaling.h"
+
+/*
+  Thread-scaling study of QuadricErrorMetrics::simplify, with index-range
+  ("qem") and spatial ("qem-spatial") thread partitions, and with midpoint
+  rather than optimal placement ("qem-midpoint"). The reference engine is
+  studied by scaling-ref, built from scaling_ref.cpp.
+*/
+static ScalingRun simplify(const char *inputFile, int noOfThreads,
+                           float fraction) {
+  ScalingRun run;
+
+  auto t0 = std::chrono::steady_clock::now();
+  Mesh *mesh = new Mesh(inputFile);
+  run.loadTime = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+  run.precision = PRECISION_NAME;
+  run.vertices = mesh->getNoOfVertices();
+  run.faces = mesh->getNoOfFaces();
+
+  QuadricErrorMetrics::simplify(mesh, fraction, noOfThreads);
+  const SimplifyReport &report = QuadricErrorMetrics::getReport();
+  run.initTime = report.quadricsTime + report.edgeCostsTime;
+  run.simplifyTime = report.simplifyTime;
+  run.collapses = report.noOfRemovedVertices;
+  run.failures = report.noOfFailures;
+  for (const ContentionReport &c : report.threads) {
+    run.conflicts += c.noOfConflicts + c.noOfBorderVertices;
+  }
+  run.outputVertices = mesh->getNoOfActiveVertices();
+  run.error = QuadricErrorMetrics::error(mesh);
+
+  delete mesh;
+  return run;
+}
+
+int main(int argc, char **argv) {
+  ScalingOptions options(argc, argv, "scaling");
+  ScalingStudy study(options, "qem");
+
+  struct Configuration {
+    const char *engine;
+    QuadricErrorMetrics::Partition partition;
+    Placement::Policy placement;
+  };
+  for (const Configuration &c :
+       {Configuration{"qem", QuadricErrorMetrics::INDEX, Placement::OPTIMAL},
+        Configuration{"qem-spatial", QuadricErrorMetrics::SPATIAL,
+                      Placement::OPTIMAL},
+        Configuration{"qem-midpoint", QuadricErrorMetrics::INDEX,
+                      Placement::MIDPOINT}}) {
+    bool spatial = c.partition == QuadricErrorMetrics::SPATIAL;
+    std::cout << std::endl
+              << "Scaling QuadricErrorMetrics::simplify ["
+              << (spatial ? "spatial" : "index") << " partitions, "
+              << Placement::getName(c.placement) << " placement]"
+              << std::endl;
+    study.setEngine(c.engine);
+    QuadricErrorMetrics::partition(c.partition);
+    QuadricErrorMetrics::placement(c.placement);
+    study.run(
+        [&](const char *inputFile, int noOfThreads, int) {
+          return simplify(inputFile, noOfThreads, options.fraction);
+        },
+        false);
+  }
+  QuadricErrorMetrics::partition(QuadricErrorMetrics::INDEX);
+  QuadricErrorMetrics::placement(Placement::OPTIMAL);
+
+  if (!study.save()) {
+    std::cerr << std::endl
+              << "Error:  Unable to create " << options.csvFile << "."
+              << std::endl;
+    exit(16);
+  }
+  std::cout << std::endl
+            << "Results written to " << options.csvFile << std::endl;
+
+  return 0;
+}
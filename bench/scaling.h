@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <omp.h>
+#include <string>
+#include <time.h>
+#include <tuple>
+#include <vector>
+
+#include "../numa.h"
+#include "bench.h"
+#include "synthetic.h"
+
+/*
+  Thread-scaling study shared by the engine harnesses. Every configuration
+  (input, grid resolution, thread count) is simplified <repetitions> times in
+  process and the run with the median total time is kept.
+
+  Strong scaling runs the same input at every thread count; speedup is
+  T(base) / T(t) and efficiency is speedup * base / t, base being the
+  smallest thread count. Weak scaling grows a synthetic grid with the thread
+  count; efficiency is T(base) / T(t) and speedup is the scaled speedup
+  efficiency * t / base. Times are init (quadrics and edge costs) plus
+  simplify, without loading.
+
+  Every study runs once per --affinity, with the team of each thread count
+  set up and pinned before the input is loaded, so mesh storage is first
+  touched by the threads that simplify it (numa.h). Pinned runs are labelled
+  <engine>+compact or <engine>+scatter.
+*/
+struct ScalingRun {
+  std::string engine;
+  std::string precision = "double"; // of positions and quadrics
+  std::string input;
+  bool weak = false;
+  int grid = 0; // grid resolution of the reference engine, 0 otherwise
+  int threads = 0;
+  int vertices = 0;
+  int faces = 0;
+
+  double loadTime = 0.0; // milliseconds
+  double initTime = 0.0;
+  double gridTime = 0.0; // part of simplifyTime
+  double simplifyTime = 0.0;
+
+  int collapses = 0;
+  int failures = 0;
+  int conflicts = 0; // failures on another thread's neighbourhood or region
+  int outputVertices = 0;
+  double error = 0.0;
+
+  double getTotalTime() const { return this->initTime + this->simplifyTime; }
+};
+
+struct ScalingOptions {
+  std::vector<int> threads;
+  std::vector<int> grids;       // synthetic inputs, vertices per side
+  std::vector<int> resolutions; // reference engine grid resolutions
+  std::vector<std::string> inputs;
+  int weak = 0; // vertices per side of the one-thread weak-scaling grid
+  float fraction = 0.5f;
+  int repetitions = 3;
+  std::string csvFile;
+  std::vector<Numa::Affinity> affinities = {Numa::NONE};
+
+  ScalingOptions(int argc, char **argv, const char *name)
+      : csvFile(std::string(name) + ".csv") {
+    Numa::Affinity affinity;
+    for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+        for (char *t = strtok(argv[++i], ","); t; t = strtok(NULL, ",")) {
+          this->threads.push_back(std::max(atoi(t), 1));
+        }
+      } else if (!strcmp(argv[i], "--grid") && i + 1 < argc) {
+        this->grids.push_back(atoi(argv[++i]));
+      } else if (!strcmp(argv[i], "--resolution") && i + 1 < argc) {
+        this->resolutions.push_back(std::max(atoi(argv[++i]), 1));
+      } else if (!strcmp(argv[i], "--weak") && i + 1 < argc) {
+        this->weak = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "--fraction") && i + 1 < argc) {
+        this->fraction = atof(argv[++i]);
+      } else if (!strcmp(argv[i], "--repetitions") && i + 1 < argc) {
+        this->repetitions = std::max(atoi(argv[++i]), 1);
+      } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+        this->csvFile = argv[++i];
+      } else if (!strcmp(argv[i], "--affinity") && i + 1 < argc &&
+                 Numa::parse(argv[i + 1], affinity) &&
+                 affinity != Numa::NONE) {
+        this->affinities.push_back(affinity);
+        i++;
+      } else if (argv[i][0] == '-') {
+        std::cerr << std::endl
+                  << "Usage:  " << name
+                  << " [--threads <t,t,...>] [--fraction <f>] "
+                     "[--repetitions <n>] [--csv <file>] [--grid <n>]... "
+                     "[--weak <n>] [--resolution <r>]... "
+                     "[--affinity compact|scatter]... [input.off]...\n"
+                  << std::endl;
+        exit(1);
+      } else {
+        this->inputs.push_back(argv[i]);
+      }
+    }
+
+    if (this->threads.empty()) {
+      int noOfProcs = omp_get_num_procs();
+      for (int t = 1; t < noOfProcs; t *= 2) {
+        this->threads.push_back(t);
+      }
+      this->threads.push_back(noOfProcs);
+    }
+    std::sort(this->threads.begin(), this->threads.end());
+
+    if (this->inputs.empty() && this->grids.empty() && !this->weak) {
+      this->inputs.push_back("bunny.off");
+      this->grids.push_back(256);
+    }
+    if (this->resolutions.empty()) {
+      this->resolutions.push_back(8);
+    }
+  }
+};
+
+class ScalingStudy {
+  const ScalingOptions &options;
+  std::string engine;
+  Numa::Affinity affinity = Numa::NONE;
+  std::vector<ScalingRun> runs;
+
+public:
+  /* <simplify>(input, threads, resolution) performs and measures one run */
+  typedef std::function<ScalingRun(const char *, int, int)> Runner;
+
+  ScalingStudy(const ScalingOptions &options, const char *engine)
+      : options(options), engine(engine) {}
+
+  /* Label of the following runs, for variants of one engine */
+  void setEngine(const std::string &engine) { this->engine = engine; }
+
+  void run(const Runner &simplify, bool gridded) {
+    for (Numa::Affinity affinity : this->options.affinities) {
+      this->affinity = affinity;
+      this->sweep(simplify, gridded);
+    }
+    Numa::bind(Numa::NONE, omp_get_max_threads());
+  }
+
+  bool save() const {
+    FILE *file = fopen(this->options.csvFile.c_str(), "w");
+    if (!file) {
+      return false;
+    }
+
+    // Baseline: the smallest thread count of every series
+    typedef std::tuple<std::string, std::string, bool, int> Series;
+    std::map<Series, const ScalingRun *> baselines;
+    for (const ScalingRun &r : this->runs) {
+      Series series(r.engine, r.weak ? "" : r.input, r.weak, r.grid);
+      if (!baselines.count(series) ||
+          baselines[series]->threads > r.threads) {
+        baselines[series] = &r;
+      }
+    }
+
+    fprintf(file, "engine,input,mode,grid,threads,vertices,faces,load_ms,"
+                  "init_ms,grid_ms,simplify_ms,total_ms,collapses,"
+                  "collapses_per_s,failures,conflicts,output_vertices,error,"
+                  "speedup,efficiency,precision\n");
+    for (const ScalingRun &r : this->runs) {
+      const ScalingRun *base = baselines.at(
+          Series(r.engine, r.weak ? "" : r.input, r.weak, r.grid));
+      double ratio = base->getTotalTime() / r.getTotalTime();
+      double scale = (double)r.threads / base->threads;
+      double speedup = r.weak ? ratio * scale : ratio;
+      double efficiency = r.weak ? ratio : ratio / scale;
+
+      fprintf(file,
+              "%s,%s,%s,%d,%d,%d,%d,%f,%f,%f,%f,%f,%d,%f,%d,%d,%d,%g,%f,%f,"
+              "%s\n",
+              r.engine.c_str(), r.input.c_str(), r.weak ? "weak" : "strong",
+              r.grid, r.threads, r.vertices, r.faces, r.loadTime, r.initTime,
+              r.gridTime, r.simplifyTime, r.getTotalTime(), r.collapses,
+              r.collapses / std::max(r.simplifyTime / 1e3, 1e-9), r.failures,
+              r.conflicts, r.outputVertices, r.error, speedup, efficiency,
+              r.precision.c_str());
+    }
+
+    return fclose(file) == 0;
+  }
+
+private:
+  /* Every input, resolution and thread count under the current affinity */
+  void sweep(const Runner &simplify, bool gridded) {
+    std::vector<int> resolutions =
+        gridded ? this->options.resolutions : std::vector<int>{0};
+
+    std::vector<std::pair<std::string, std::string>> inputs;
+    for (const std::string &input : this->options.inputs) {
+      inputs.push_back(std::make_pair(input, input));
+    }
+    for (int n : this->options.grids) {
+      inputs.push_back(std::make_pair("grid-" + std::to_string(n),
+                                      writeSynthetic(n)));
+    }
+
+    for (auto &input : inputs) {
+      for (int resolution : resolutions) {
+        for (int t : this->options.threads) {
+          measure(simplify, input.first, input.second, false, t, resolution);
+        }
+      }
+      if (input.first != input.second) {
+        unlink(input.second.c_str());
+      }
+    }
+
+    if (this->options.weak) {
+      for (int resolution : resolutions) {
+        for (int t : this->options.threads) {
+          int n = lround(this->options.weak *
+                         sqrt((double)t / this->options.threads.front()));
+          std::string path = writeSynthetic(n);
+          measure(simplify, "grid-" + std::to_string(n), path, true, t,
+                  resolution);
+          unlink(path.c_str());
+        }
+      }
+    }
+  }
+
+  static std::string writeSynthetic(int n) {
+    std::string path = writeSyntheticGrid(n);
+    if (path.empty()) {
+      std::cerr << std::endl
+                << "Error:  Unable to create synthetic mesh." << std::endl;
+      exit(17);
+    }
+    return path;
+  }
+
+  void measure(const Runner &simplify, const std::string &name,
+               const std::string &path, bool weak, int threads,
+               int resolution) {
+    omp_set_num_threads(threads);
+    Numa::bind(this->affinity, threads);
+
+    std::vector<ScalingRun> samples;
+    for (int i = 0; i < this->options.repetitions; i++) {
+      QuietOutput quiet;
+      samples.push_back(simplify(path.c_str(), threads, resolution));
+    }
+    std::sort(samples.begin(), samples.end(),
+              [](const ScalingRun &a, const ScalingRun &b) {
+                return a.getTotalTime() < b.getTotalTime();
+              });
+
+    ScalingRun run = samples[samples.size() / 2];
+    run.engine = this->engine;
+    if (this->affinity != Numa::NONE) {
+      run.engine += std::string("+") + Numa::getName(this->affinity);
+    }
+    run.input = name;
+    run.weak = weak;
+    run.grid = resolution;
+    run.threads = threads;
+    this->runs.push_back(run);
+
+    std::cout << "  " << name << (weak ? " (weak)" : "");
+    if (resolution) {
+      std::cout << " grid " << resolution;
+    }
+    std::cout << " threads " << threads << ": " << run.getTotalTime()
+              << " ms, " << run.collapses << " collapse(s), " << run.failures
+              << " failure(s), " << run.conflicts << " conflict(s)"
+              << std::endl;
+  }
+};
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <iostream>
+
+#include "../ref/SimpELEN.h"
+#include "../ref/SimpQEM.h"
+#include "../ref/Surface.h"
+#include "scaling.h"
+
+/*
+  Thread-scaling study of the reference engine across grid resolutions,
+  mirroring scaling.cpp, for every cost policy of its driver: edge length
+  ("ref-elen"), quadric error at the midpoint ("ref-qem") and at the optimal
+  placement ("ref-qem-optimal"). Edge length keeps no quadrics, so its error
+  column is 0.
+*/
+template <class Simp>
+static ScalingRun simplify(const char *inputFile, int noOfThreads,
+                           int resolution, float fraction) {
+  ScalingRun run;
+
+  auto t0 = std::chrono::steady_clock::now();
+  Surface *s = new Surface(inputFile);
+  run.loadTime = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - t0)
+                     .count();
+  run.vertices = s->m_points.size();
+  run.faces = s->m_faces.size();
+
+  Simp *qem = new Simp(s, noOfThreads);
+  qem->simplify(fraction * s->m_points.size(), resolution);
+  run.initTime = qem->time_init;
+  run.gridTime = qem->time_grid;
+  run.simplifyTime = qem->time_simplify;
+  run.collapses = qem->vertices_removed;
+  run.failures = qem->failed_pop;
+  for (point_vec_it pit = s->m_points.begin(); pit != s->m_points.end();
+       ++pit) {
+    if (!(*pit)->removed) {
+      run.outputVertices++;
+      if (Simp::CostPolicy::QUADRICS)
+        run.error += qem->getCost(*pit);
+    }
+  }
+
+  delete qem;
+  delete s;
+  return run;
+}
+
+int main(int argc, char **argv) {
+  ScalingOptions options(argc, argv, "scaling-ref");
+  ScalingStudy study(options, "ref-elen");
+
+  std::cout << std::endl << "Scaling SimpELEN::simplify" << std::endl;
+  study.run(
+      [&](const char *inputFile, int noOfThreads, int resolution) {
+        return simplify<SimpELEN>(inputFile, noOfThreads, resolution,
+                                  options.fraction);
+      },
+      true);
+
+  std::cout << std::endl << "Scaling SimpQEM::simplify" << std::endl;
+  study.setEngine("ref-qem");
+  study.run(
+      [&](const char *inputFile, int noOfThreads, int resolution) {
+        return simplify<SimpQEM>(inputFile, noOfThreads, resolution,
+                                 options.fraction);
+      },
+      true);
+
+  std::cout << std::endl << "Scaling SimpQEMOptimal::simplify" << std::endl;
+  study.setEngine("ref-qem-optimal");
+  study.run(
+      [&](const char *inputFile, int noOfThreads, int resolution) {
+        return simplify<SimpQEMOptimal>(inputFile, noOfThreads, resolution,
+                                        options.fraction);
+      },
+      true);
+
+  if (!study.save()) {
+    std::cerr << std::endl
+              << "Error:  Unable to create " << options.csvFile << "."
+              << std::endl;
+    exit(16);
+  }
+  std::cout << std::endl
+            << "Results written to " << options.csvFile << std::endl;
+
+  return 0;
+}
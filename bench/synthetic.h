@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+/*
+  Write an <n> x <n> vertex height field, split into 2 (n - 1)^2 triangles,
+  as OFF to a new temporary file and return its path (empty on error). The
+  surface is a product of sines, so the quadrics are non-trivial and the
+  collapse order is not degenerate. The caller removes the file.
+*/
+inline std::string writeSyntheticGrid(int n) {
+  char path[] = "/tmp/mesh-bench-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return "";
+  }
+
+  FILE *file = fdopen(fd, "w");
+  if (!file) {
+    close(fd);
+    unlink(path);
+    return "";
+  }
+
+  fprintf(file, "OFF\n");
+  fprintf(file, "%d %d %d\n", n * n, 2 * (n - 1) * (n - 1), 0);
+
+  double step = 1.0 / (n - 1);
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      double x = i * step;
+      double y = j * step;
+      double z = 0.05 * sin(6.0 * M_PI * x) * sin(4.0 * M_PI * y);
+      fprintf(file, "%lf %lf %lf\n", x, y, z);
+    }
+  }
+
+  for (int j = 0; j + 1 < n; j++) {
+    for (int i = 0; i + 1 < n; i++) {
+      int v = j * n + i;
+      fprintf(file, "%d %d %d %d\n", 3, v, v + 1, v + n + 1);
+      fprintf(file, "%d %d %d %d\n", 3, v, v + n + 1, v + n);
+    }
+  }
+
+  if (fclose(file)) {
+    unlink(path);
+    return "";
+  }
+
+  return path;
+}
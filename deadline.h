@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+  Wall-clock budget for a simplification run. A watchdog thread sleeps until
+  the budget is spent and then raises a flag, so the collapse loops only pay
+  for a relaxed atomic load per iteration instead of a clock read. Destroying
+  the deadline before it expires wakes and joins the watchdog.
+*/
+class Deadline {
+  std::atomic<bool> expired;
+  std::mutex mutex;
+  std::condition_variable cancel;
+  bool cancelled;
+  std::thread watchdog;
+
+public:
+  Deadline() = delete;
+  Deadline(const Deadline &) = delete;
+
+  /* A budget of zero or less never expires */
+  Deadline(long long milliseconds) : expired(false), cancelled(false) {
+    if (milliseconds <= 0) {
+      return;
+    }
+
+    auto end = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(milliseconds);
+    this->watchdog = std::thread([this, end]() {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      if (!this->cancel.wait_until(lock, end,
+                                   [this]() { return this->cancelled; })) {
+        this->expired.store(true, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  ~Deadline() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->cancelled = true;
+    }
+    this->cancel.notify_one();
+    if (this->watchdog.joinable()) {
+      this->watchdog.join();
+    }
+  }
+
+  bool isExpired() const {
+    return this->expired.load(std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+  Per-vertex diagnostics of one simplification run, written as a colored OFF
+  (COFF) of the input mesh to show where on the model the work and the
+  trouble are.
+
+  Engines hold a Heatmap pointer that is NULL unless the diagnostic was asked
+  for, so a disabled heatmap costs one predictable branch per sampled vertex
+  or popped edge. Counters of a vertex may be bumped by several threads and
+  are updated atomically; removal data is written once, by the thread that
+  removes the vertex.
+
+  Channels:
+    failures   samples or pops of the vertex that did not lead to a collapse
+    conflicts  failures because another thread held the neighbourhood, or
+               the vertex lay on a region border (none in the reference
+               engine, whose cells are independent)
+    thread     thread that removed the vertex
+    cell       grid cell (or thread block or region) the vertex was removed
+               from
+    round      round (or level of detail) in which the vertex was removed
+    order      position of the vertex in the removal sequence
+  Counts and orders are colored on a blue-to-red ramp, threads and cells get
+  one color each, and vertices never removed are gray on removal channels.
+*/
+class Heatmap {
+public:
+  enum Channel { FAILURES, CONFLICTS, THREAD, CELL, ROUND, ORDER };
+
+private:
+  std::vector<double> vertices; // input positions, 3 per vertex
+  std::vector<int> faces;       // input triangles, 3 per face
+
+  std::vector<int> failures;
+  std::vector<int> conflicts;
+  std::vector<int> thread; // -1 while the vertex is alive
+  std::vector<int> cell;
+  std::vector<int> round;
+  std::vector<int> order;
+  int noOfRemovals;
+
+  static void ramp(double t, int rgb[3]) {
+    // Blue, cyan, green, yellow, red
+    static const int stops[5][3] = {
+        {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}};
+    t = std::min(std::max(t, 0.0), 1.0) * 4;
+    int s = std::min((int)t, 3);
+    double f = t - s;
+    for (int c = 0; c < 3; c++) {
+      rgb[c] = lround(stops[s][c] + f * (stops[s + 1][c] - stops[s][c]));
+    }
+  }
+
+  /* Distinct, stable colors for small categorical values */
+  static void palette(int value, int rgb[3]) {
+    uint32_t h = (uint32_t)(value + 1) * 2654435761u;
+    for (int c = 0; c < 3; c++) {
+      rgb[c] = 64 + (h >> (8 * c) & 0xff) * 191 / 255;
+    }
+  }
+
+public:
+  Heatmap() = delete;
+  Heatmap(const std::vector<double> &vertices, const std::vector<int> &faces)
+      : vertices(vertices), faces(faces), noOfRemovals(0) {
+    int n = vertices.size() / 3;
+    this->failures.assign(n, 0);
+    this->conflicts.assign(n, 0);
+    this->thread.assign(n, -1);
+    this->cell.assign(n, -1);
+    this->round.assign(n, -1);
+    this->order.assign(n, -1);
+  }
+
+  static bool parseChannel(const char *name, Channel &channel) {
+    static const char *names[] = {"failures", "conflicts", "thread",
+                                  "cell",     "round",     "order"};
+    for (int c = 0; c <= ORDER; c++) {
+      if (!strcmp(name, names[c])) {
+        channel = (Channel)c;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void fail(int vertex) {
+#pragma omp atomic
+    this->failures[vertex]++;
+  }
+
+  void conflict(int vertex) {
+    this->fail(vertex);
+#pragma omp atomic
+    this->conflicts[vertex]++;
+  }
+
+  void remove(int vertex, int thread, int cell, int round) {
+    int position;
+#pragma omp atomic capture
+    position = this->noOfRemovals++;
+    this->thread[vertex] = thread;
+    this->cell[vertex] = cell;
+    this->round[vertex] = round;
+    this->order[vertex] = position;
+  }
+
+  /* Write the input mesh colored by <channel>; returns false on error */
+  bool save(const char *offFile, Channel channel) const {
+    FILE *file = fopen(offFile, "w");
+    if (!file) {
+      return false;
+    }
+
+    const std::vector<int> *values[] = {&this->failures, &this->conflicts,
+                                        &this->thread,   &this->cell,
+                                        &this->round,    &this->order};
+    const std::vector<int> &value = *values[channel];
+    bool categorical = channel == THREAD || channel == CELL;
+    bool removal = channel >= THREAD;
+
+    // Counts go on a log scale, so a few hot spots do not wash out the rest
+    int max = std::max(1, *std::max_element(value.begin(), value.end()));
+    double scale = channel <= CONFLICTS ? log1p(max) : max;
+
+    int n = value.size();
+    fprintf(file, "COFF\n%d %d 0\n", n, (int)this->faces.size() / 3);
+    for (int v = 0; v < n; v++) {
+      int rgb[3] = {160, 160, 160};
+      if (categorical && value[v] >= 0) {
+        palette(value[v], rgb);
+      } else if (!removal) {
+        ramp(log1p(value[v]) / scale, rgb);
+      } else if (value[v] >= 0) {
+        ramp(value[v] / scale, rgb);
+      }
+      fprintf(file, "%lf %lf %lf %d %d %d 255\n", this->vertices[3 * v],
+              this->vertices[3 * v + 1], this->vertices[3 * v + 2], rgb[0],
+              rgb[1], rgb[2]);
+    }
+    for (int f = 0; f < (int)this->faces.size(); f += 3) {
+      fprintf(file, "3 %d %d %d\n", this->faces[f], this->faces[f + 1],
+              this->faces[f + 2]);
+    }
+
+    return fclose(file) == 0;
+  }
+};
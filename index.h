@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/*
+  Type of vertex, face and edge ids, and of counts of them. 32 bits by
+  default, which keeps ids, id lists and per-vertex arrays dense in cache;
+  make INDEX64=1 builds with 64-bit ids for meshes of more than 2^31 - 1
+  elements (edges run out first, at about 1.4G triangles). Run make clean
+  first, objects are not rebuilt when it changes.
+
+  Mesh::read() refuses inputs whose counts do not fit, rather than wrap.
+*/
+#ifdef INDEX64
+typedef int64_t Index;
+#else
+typedef int32_t Index;
+#endif
+
+static const Index MAX_INDEX = std::numeric_limits<Index>::max();
+
+/* Uniform offset in [0, <length>) from 31-bit rand() style draws */
+template <typename Random> inline Index randomIndex(Index length, Random draw) {
+  uint64_t r = draw();
+  if (sizeof(Index) > 4) {
+    r = r << 31 | draw();
+  }
+  return r % length;
+}
@@ -1,8 +1,16 @@
+#include <cfloat>
+#include <cstring>
 #include <iostream>
+#include <omp.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "mesh.h"
+#include "numa.h"
 #include "qem.h"
-#include <time.h>
+#include "stream.h"
+#include "telemetry.h"
 
 // http://en.wikipedia.org/wiki/ANSI_escape_code
 // http://stackoverflow.com/questions/5947742/how-to-change-the-output-color-of-echo-in-linux
@@ -28,66 +36,556 @@ const std::string
 const std::string underlinetty("\033[4m"); // tell tty to switch to underline
 const std::string deftty("\033[0m"); // tell tty to switch back to default color
 
-// source:
-// http://www.guyrutenberg.com/2007/09/22/profiling-code-using-clock_gettime/
-timespec diff(timespec start, timespec end) {
-  timespec temp;
-  if ((end.tv_nsec - start.tv_nsec) < 0) {
-    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
-    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
-  } else {
-    temp.tv_sec = end.tv_sec - start.tv_sec;
-    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
-  }
-  return temp;
+void usage() {
+  std::cerr << std::endl
+            << "Usage:  ./mesh-simplification <input file> <simplification "
+               "fraction> <no of blocks> <no of threads> [options]\n"
+            << std::endl
+            << "A comma-separated list of fractions (e.g. 0.25,0.5,0.75) "
+               "writes one level of detail per fraction, lod<i>.off, from a "
+               "single pass."
+            << std::endl
+            << std::endl
+            << "Options:" << std::endl
+            << "  --hybrid <fraction>  Remove <fraction> of the vertices by "
+               "vertex clustering before QEM"
+            << std::endl
+            << "  --stream <faces>     Simplify out of core, keeping at most "
+               "about <faces> triangles in memory"
+            << std::endl
+            << "  --pm <file>          Log every collapse to a progressive "
+               "mesh file"
+            << std::endl
+            << "  --max-error <error>  Reject collapses costing more than "
+               "<error> and stop once none are left"
+            << std::endl
+            << "  --deadline <ms>      Stop simplifying <ms> milliseconds "
+               "after start and keep the mesh as it is"
+            << std::endl
+            << "  --compare            Also run pure QEM and report its time "
+               "and error (one run per fraction for a chain)"
+            << std::endl
+            << "  --telemetry <file>   Write phase times and counters of the "
+               "run to a JSON file"
+            << std::endl
+            << "  --trace <file>       Write a per-thread timeline of the run "
+               "in Chrome trace format"
+            << std::endl
+            << "  --contention         Break failed iterations down by cause "
+               "for every thread block"
+            << std::endl
+            << "  --heatmap <file>     Write the input mesh as COFF, colored "
+               "by a per-vertex diagnostic"
+            << std::endl
+            << "  --heatmap-by <what>  Diagnostic of the heatmap: failures "
+               "(default), conflicts, thread, cell, round or order"
+            << std::endl
+            << "  --perf               Add hardware counters (cycles, "
+               "instructions, cache and branch misses) to every phase"
+            << std::endl
+            << "  --partition <how>    Split the collapse loop among threads "
+               "by index ranges (default) or spatial regions"
+            << std::endl
+            << "  --reorder <curve>    Renumber vertices and faces along a "
+               "morton or hilbert curve at load, for locality"
+            << std::endl
+            << "  --affinity <how>     Pin threads to CPUs: compact (one NUMA "
+               "node after another), scatter (across nodes) or none"
+            << std::endl
+            << "  --placement <where>  Move the surviving vertex of a collapse "
+               "to the error minimum (optimal, default) or the midpoint"
+            << std::endl
+            << std::endl;
 }
 
-long long int getMilliseconds(timespec t) {
-  return t.tv_sec * 1000 + t.tv_nsec / 1000000;
+/* One line per thread block of the collapse loop, then the total */
+void printContention(const std::vector<ContentionReport> &threads,
+                     const ContentionReport &total) {
+  std::cout << std::endl
+            << "Block\tCollapses\tRemoved\tNo faces\tConflicts\tBorder\t"
+               "Rejected";
+  if (Telemetry::isEnabled()) {
+    std::cout << "\tWait (ms)\tp50 (ns)\tp99 (ns)";
+  }
+  std::cout << std::endl;
+
+  for (int i = 0; i <= (int)threads.size(); i++) {
+    const ContentionReport &c = i < (int)threads.size() ? threads[i] : total;
+    if (i < (int)threads.size()) {
+      std::cout << i;
+    } else {
+      std::cout << "Total";
+    }
+    std::cout << "\t" << c.noOfCollapses << "\t\t" << c.noOfRemovedVertices
+              << "\t" << c.noOfBareVertices << "\t\t" << c.noOfConflicts
+              << "\t\t" << c.noOfBorderVertices << "\t" << c.noOfRejections;
+    if (Telemetry::isEnabled()) {
+      std::cout << "\t\t" << c.waitTime << "\t\t" << c.latency.percentile(50)
+                << "\t\t" << c.latency.percentile(99);
+    }
+    std::cout << std::endl;
+  }
 }
 
-long long int getNanoseconds(timespec t) {
-  return (1000000000 * t.tv_sec) + t.tv_nsec;
+/* Heap allocations of every phase ended so far, nested phases indented */
+void printAllocations() {
+  std::cout << std::endl << "Phase\t\tAllocations\tBytes\t\tPeak live bytes"
+            << std::endl;
+  for (const Telemetry::Phase &phase : Telemetry::get().getPhases()) {
+    std::string name = std::string(2 * phase.depth, ' ') + phase.name;
+    std::cout << name;
+    bool narrow = name.size() < 8;
+    for (const char *counter :
+         {"allocations", "allocated_bytes", "peak_live_bytes"}) {
+      long long value = 0;
+      for (auto &c : phase.counters) {
+        if (c.first == counter) {
+          value = c.second;
+        }
+      }
+      std::cout << (narrow ? "\t\t" : "\t") << value;
+      narrow = value < 10000000;
+    }
+    std::cout << std::endl;
+  }
 }
 
 int main(int argc, char **argv) {
   if (argc < 5) {
-    std::cerr << std::endl
-              << "Usage:  ./mesh-simplification <input file> <simplification "
-                 "fraction> <no of blocks> <no of threads>\n"
-              << std::endl;
+    usage();
     exit(1);
   }
 
   char *inputFile = argv[1];
-  float simplificationFraction = atof(argv[2]);
+  std::vector<float> fractions;
+  for (char *f = strtok(argv[2], ","); f; f = strtok(NULL, ",")) {
+    fractions.push_back(atof(f));
+  }
+  std::sort(fractions.begin(), fractions.end());
+  float simplificationFraction = fractions.empty() ? 0.0f : fractions.back();
+  bool chain = fractions.size() > 1;
   int noOfBlocks = atoi(argv[3]);
   int noOfThreads = atoi(argv[4]);
 
-  if (simplificationFraction >= 1.0f) {
+  float intermediateFraction = 0.0f;
+  int windowSize = 0;
+  char *logFile = NULL;
+  double maxError = DBL_MAX;
+  long long budget = 0;
+  bool compare = false;
+  char *telemetryFile = NULL;
+  char *traceFile = NULL;
+  bool contention = false;
+  bool perf = false;
+  char *heatmapFile = NULL;
+  Heatmap::Channel heatmapChannel = Heatmap::FAILURES;
+  SpaceFillingCurve::Curve curve = SpaceFillingCurve::NONE;
+  QuadricErrorMetrics::Partition partition = QuadricErrorMetrics::INDEX;
+  Numa::Affinity affinity = Numa::NONE;
+  Placement::Policy placement = Placement::OPTIMAL;
+  for (int i = 5; i < argc; i++) {
+    if (!strcmp(argv[i], "--hybrid") && i + 1 < argc) {
+      intermediateFraction = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--stream") && i + 1 < argc) {
+      windowSize = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--pm") && i + 1 < argc) {
+      logFile = argv[++i];
+    } else if (!strcmp(argv[i], "--max-error") && i + 1 < argc) {
+      maxError = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--deadline") && i + 1 < argc) {
+      budget = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--compare")) {
+      compare = true;
+    } else if (!strcmp(argv[i], "--telemetry") && i + 1 < argc) {
+      telemetryFile = argv[++i];
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      traceFile = argv[++i];
+    } else if (!strcmp(argv[i], "--contention")) {
+      contention = true;
+    } else if (!strcmp(argv[i], "--perf")) {
+      perf = true;
+    } else if (!strcmp(argv[i], "--heatmap") && i + 1 < argc) {
+      heatmapFile = argv[++i];
+    } else if (!strcmp(argv[i], "--heatmap-by") && i + 1 < argc &&
+               Heatmap::parseChannel(argv[i + 1], heatmapChannel)) {
+      i++;
+    } else if (!strcmp(argv[i], "--partition") && i + 1 < argc &&
+               (!strcmp(argv[i + 1], "index") ||
+                !strcmp(argv[i + 1], "spatial"))) {
+      partition = strcmp(argv[++i], "spatial") ? QuadricErrorMetrics::INDEX
+                                               : QuadricErrorMetrics::SPATIAL;
+    } else if (!strcmp(argv[i], "--reorder") && i + 1 < argc &&
+               SpaceFillingCurve::parse(argv[i + 1], curve)) {
+      i++;
+    } else if (!strcmp(argv[i], "--affinity") && i + 1 < argc &&
+               Numa::parse(argv[i + 1], affinity)) {
+      i++;
+    } else if (!strcmp(argv[i], "--placement") && i + 1 < argc &&
+               Placement::parse(argv[i + 1], placement)) {
+      i++;
+    } else {
+      usage();
+      exit(3);
+    }
+  }
+
+  if (fractions.empty() || fractions.front() < 0.0f ||
+      simplificationFraction >= 1.0f) {
     std::cerr << std::endl
-              << "Error:  Simplification fraction should be less than 1.0.\n"
+              << "Error:  Simplification fraction should be between 0.0 and "
+                 "1.0.\n"
               << std::endl;
     exit(2);
   }
 
+  if (intermediateFraction < 0.0f ||
+      intermediateFraction > simplificationFraction) {
+    std::cerr << std::endl
+              << "Error:  Clustering fraction should be between 0.0 and the "
+                 "simplification fraction.\n"
+              << std::endl;
+    exit(4);
+  }
+
+  if (windowSize > 0 && logFile) {
+    std::cerr << std::endl
+              << "Error:  Progressive mesh logging is not available in "
+                 "streaming mode.\n"
+              << std::endl;
+    exit(5);
+  }
+
+  if (windowSize > 0 && heatmapFile) {
+    std::cerr << std::endl
+              << "Error:  Heatmaps are not available in streaming mode.\n"
+              << std::endl;
+    exit(8);
+  }
+
+  // Clustering renumbers the vertices, and its merges are not edge collapses
+  if (intermediateFraction > 0.0f && (logFile || heatmapFile)) {
+    std::cerr << std::endl
+              << "Error:  Progressive mesh logging and heatmaps are not "
+                 "available in hybrid mode.\n"
+              << std::endl;
+    exit(10);
+  }
+
+  if (windowSize > 0 && (curve != SpaceFillingCurve::NONE ||
+                         partition != QuadricErrorMetrics::INDEX)) {
+    std::cerr << std::endl
+              << "Error:  Reordering and partitioning are not available in "
+                 "streaming mode.\n"
+              << std::endl;
+    exit(9);
+  }
+
+  if (windowSize > 0 && (maxError < DBL_MAX || budget > 0)) {
+    std::cerr << std::endl
+              << "Error:  Error and time limits are not available in "
+                 "streaming mode.\n"
+              << std::endl;
+    exit(7);
+  }
+
+  if (chain && (intermediateFraction > 0.0f || windowSize > 0)) {
+    std::cerr << std::endl
+              << "Error:  A chain of fractions is only available with pure "
+                 "QEM.\n"
+              << std::endl;
+    exit(6);
+  }
+
   std::cout << std::endl;
   std::cout << "Input File              : " << inputFile << std::endl;
-  std::cout << "Simplification Fraction : " << simplificationFraction
-            << std::endl;
+  std::cout << "Simplification Fraction : ";
+  for (int i = 0; i < (int)fractions.size(); i++) {
+    std::cout << (i ? "," : "") << fractions[i];
+  }
+  std::cout << std::endl;
+  if (intermediateFraction > 0.0f) {
+    std::cout << "Clustering Fraction     : " << intermediateFraction
+              << std::endl;
+  }
+  if (windowSize > 0) {
+    std::cout << "Window Size             : " << windowSize << std::endl;
+  }
+  if (maxError < DBL_MAX) {
+    std::cout << "Maximum Error           : " << maxError << std::endl;
+  }
+  if (budget > 0) {
+    std::cout << "Deadline                : " << budget << " ms" << std::endl;
+  }
+  if (curve != SpaceFillingCurve::NONE) {
+    std::cout << "Vertex Order            : "
+              << (curve == SpaceFillingCurve::HILBERT ? "hilbert" : "morton")
+              << std::endl;
+  }
   std::cout << "Number Of Blocks        : " << noOfBlocks << std::endl;
   std::cout << "Number Of Threads       : " << noOfThreads << std::endl;
+  if (partition == QuadricErrorMetrics::SPATIAL) {
+    std::cout << "Partitioning            : spatial" << std::endl;
+  }
+  std::cout << "Placement               : " << Placement::getName(placement)
+            << std::endl;
+  std::cout << "Precision               : " << PRECISION_NAME << std::endl;
+
+  // Mesh storage is first touched by a team of this size, so set it and pin
+  // it before anything is loaded
+  omp_set_num_threads(noOfThreads);
+  if (affinity != Numa::NONE) {
+    bool bound = Numa::bind(affinity, noOfThreads);
+    std::cout << "Thread Affinity         : " << Numa::getName(affinity)
+              << " [" << Numa::getNoOfNodes() << " NUMA node(s)"
+              << (bound ? "" : ", not available") << "]" << std::endl;
+  }
+
+  const char *label = "QEM   ";
+  double error = 0.0;
+  Index noOfVertices = 0;
+
+  if (perf) {
+    std::vector<std::string> events;
+    if (PerfCounters::get().enable(noOfThreads)) {
+      events = PerfCounters::get().getNames();
+    }
+    std::cout << "Performance Counters    : ";
+    for (int e = 0; e < (int)events.size(); e++) {
+      std::cout << (e ? ", " : "") << events[e];
+    }
+    std::cout << (events.empty() ? "unavailable" : "") << std::endl;
+  }
+  if (traceFile) {
+    Tracer::get().enable();
+  }
+  Telemetry::get().reset();
+  ScopedPhase total("total");
+  Deadline *deadline = new Deadline(budget);
+  QuadricErrorMetrics::limit(maxError, deadline);
+  QuadricErrorMetrics::partition(partition);
+  QuadricErrorMetrics::placement(placement);
+  Mesh *mesh = NULL;
+  ProgressiveMesh *progressiveMesh = NULL;
+  Heatmap *heatmap = NULL;
+  std::vector<std::string> lodFiles;
+  std::vector<MeshSnapshot> lods(fractions.size());
+  std::vector<char> lodSaved(fractions.size(), 0);
+  std::vector<std::thread> writers;
+  if (windowSize > 0) {
+    label = "Stream";
+    StreamingSimplifier streaming(inputFile, windowSize, placement);
+    streaming.simplify(simplificationFraction, "tmp.off");
+    error = streaming.getError();
+    noOfVertices = streaming.getNoOfOutputVertices();
+  } else {
+    {
+      ScopedPhase load("load");
+      mesh = new Mesh(inputFile, curve);
+    }
+    Telemetry::get().setValue("vertex_bytes", mesh->getVertexMemoryUsage());
+    Telemetry::get().setValue("numa_nodes", Numa::getNoOfNodes());
+
+    // Both keep 32-bit ids, whatever the index width of the build
+    if ((logFile || heatmapFile) &&
+        std::max(mesh->getNoOfVertices(), mesh->getNoOfFaces()) > INT32_MAX) {
+      std::cerr << std::endl
+                << "Error:  Progressive mesh logs and heatmaps are limited to "
+                << INT32_MAX << " vertices and faces.\n"
+                << std::endl;
+      exit(19);
+    }
+    if (logFile) {
+      progressiveMesh = new ProgressiveMesh(mesh);
+      QuadricErrorMetrics::record(progressiveMesh);
+    }
+    if (heatmapFile) {
+      std::vector<double> positions;
+      for (const Vertex *v : mesh->getVertices()) {
+        positions.insert(positions.end(), {v->getX(), v->getY(), v->getZ()});
+      }
+      std::vector<int> triangles;
+      for (const Face *f : mesh->getFaces()) {
+        for (int i = 0; i < 3; i++) {
+          triangles.push_back(f->getVertex(i)->getId());
+        }
+      }
+      heatmap = new Heatmap(positions, triangles);
+      QuadricErrorMetrics::diagnose(heatmap);
+    }
+
+    if (chain) {
+      label = "Chain ";
+      for (int i = 0; i < (int)fractions.size(); i++) {
+        lodFiles.push_back("lod" + std::to_string(i) + ".off");
+      }
 
-  timespec t0, t1, t;
-  clock_gettime(CLOCK_REALTIME, &t0);
-  Mesh *mesh = new Mesh(inputFile);
-  QuadricErrorMetrics::simplify(mesh, simplificationFraction, noOfBlocks,
-                                noOfThreads);
-  clock_gettime(CLOCK_REALTIME, &t1);
-  t = diff(t0, t1);
-  std::cout << lightgreentty << "TOTAL TIME: " << getMilliseconds(t) << " ms"
+      // Each level is written on its own thread while simplification goes on
+      QuadricErrorMetrics::simplifyChain(
+          mesh, fractions,
+          [&](int i) {
+            lods[i] = mesh->snapshot();
+            writers.emplace_back([&, i]() {
+              lodSaved[i] = lods[i].saveAsOFF(lodFiles[i].c_str());
+            });
+          },
+          noOfThreads);
+
+      for (std::thread &writer : writers) {
+        writer.join();
+      }
+    } else if (intermediateFraction > 0.0f) {
+      label = "Hybrid";
+      QuadricErrorMetrics::simplifyHybrid(mesh, simplificationFraction,
+                                          intermediateFraction, noOfBlocks,
+                                          noOfThreads);
+    } else {
+      QuadricErrorMetrics::simplify(mesh, simplificationFraction, noOfThreads);
+    }
+
+    QuadricErrorMetrics::record(NULL);
+    QuadricErrorMetrics::diagnose(NULL);
+  }
+  long long totalTime = total.stop();
+  std::cout << lightgreentty << "TOTAL TIME: " << totalTime << " ms"
             << deftty << std::endl;
-  mesh->saveAsOFF("tmp.off");
+
+  QuadricErrorMetrics::limit(DBL_MAX, NULL);
+  delete deadline;
+
+  if (mesh) {
+    const SimplifyReport &report = QuadricErrorMetrics::getReport();
+    Telemetry::get().setValue("removed_vertices", report.noOfRemovedVertices);
+    Telemetry::get().setValue("failures", report.noOfFailures);
+    Telemetry::get().setValue("max_error", report.maxError);
+
+    ContentionReport total;
+    for (const ContentionReport &c : report.threads) {
+      total.merge(c);
+    }
+    Telemetry::get().setValue("failures_removed", total.noOfRemovedVertices);
+    Telemetry::get().setValue("failures_no_faces", total.noOfBareVertices);
+    Telemetry::get().setValue("failures_conflict", total.noOfConflicts);
+    Telemetry::get().setValue("failures_border", total.noOfBorderVertices);
+    Telemetry::get().setValue("failures_rejected", total.noOfRejections);
+    if (Telemetry::isEnabled()) {
+      Telemetry::get().setValue("critical_wait_ms", total.waitTime);
+      Telemetry::get().setValue("collapse_p50_ns",
+                                total.latency.percentile(50));
+      Telemetry::get().setValue("collapse_p99_ns",
+                                total.latency.percentile(99));
+    }
+
+    std::cout << "Removed " << report.noOfRemovedVertices
+              << " vertex(s), max error " << report.maxError;
+    if (report.stoppedAtDeadline) {
+      std::cout << " [stopped at deadline]";
+    } else if (report.stoppedAtError) {
+      std::cout << " [stopped at error threshold]";
+    }
+    std::cout << std::endl;
+
+    // Clustering and the collapse loop, the phases that remove vertices
+    double collapseTime = report.clusteringTime + report.simplifyTime;
+    if (collapseTime > 0) {
+      double rate = report.noOfRemovedVertices / (collapseTime / 1e3);
+      Telemetry::get().setValue("collapses_per_s", rate);
+      std::cout << "Collapse Rate: " << rate << " vertex(s)/s" << std::endl;
+    }
+
+    if (contention) {
+      printContention(report.threads, total);
+    }
+  }
+
+  for (int i = 0; i < (int)lodFiles.size(); i++) {
+    if (!lodSaved[i]) {
+      std::cerr << std::endl
+                << "Error:  Unable to create " << lodFiles[i] << "."
+                << std::endl;
+      exit(16);
+    }
+    std::cout << "LOD " << i << " [" << fractions[i]
+              << "]: " << lods[i].getNoOfVertices() << " vertex(s), "
+              << lods[i].getNoOfFaces() << " face(s) -> " << lodFiles[i]
+              << std::endl;
+  }
+
+  if (compare) {
+    if (mesh) {
+      error = QuadricErrorMetrics::error(mesh);
+      noOfVertices = mesh->getNoOfActiveVertices();
+    }
+
+    /*
+      A chain is compared against one independent run per fraction, each
+      loading, simplifying and writing its own level.
+    */
+    ScopedPhase comparison("compare");
+    Mesh *baseline = NULL;
+    for (float fraction : (chain ? fractions : std::vector<float>{
+                                                   simplificationFraction})) {
+      // Only the last level is reported; earlier ones would stay live and
+      // slow the later runs down
+      delete baseline;
+      baseline = new Mesh(inputFile, curve);
+      QuadricErrorMetrics::simplify(baseline, fraction, noOfThreads);
+      if (chain && !baseline->snapshot().saveAsOFF("/dev/null")) {
+        exit(16);
+      }
+    }
+    long long baselineTime = comparison.stop();
+
+    std::cout << std::endl;
+    std::cout << "                  " << label << "          QEM"
+              << std::endl;
+    std::cout << "Time (ms)       : " << totalTime << "\t\t" << baselineTime
+              << std::endl;
+    std::cout << "Vertex(s)       : " << noOfVertices << "\t\t"
+              << baseline->getNoOfActiveVertices() << std::endl;
+    std::cout << "Error (sum vQv) : " << error << "\t"
+              << QuadricErrorMetrics::error(baseline) << std::endl;
+    delete baseline;
+  }
+
+  if (progressiveMesh) {
+    progressiveMesh->save(logFile);
+  }
+
+  if (heatmap) {
+    std::cout << std::endl << "Saving heatmap... ";
+    if (!heatmap->save(heatmapFile, heatmapChannel)) {
+      std::cerr << std::endl
+                << "Error:  Unable to create " << heatmapFile << "."
+                << std::endl;
+      exit(16);
+    }
+    std::cout << "Done" << std::endl;
+  }
+
+  if (mesh && !chain) {
+    mesh->saveAsOFF("tmp.off");
+  }
+
+  if (AllocationProfile::isEnabled()) {
+    printAllocations();
+  }
+
+  if (telemetryFile) {
+    Telemetry::get().setValue("threads", noOfThreads);
+    Telemetry::get().setValue("total_ms", totalTime);
+    if (!Telemetry::get().save(telemetryFile)) {
+      std::cerr << std::endl
+                << "Error:  Unable to create " << telemetryFile << "."
+                << std::endl;
+      exit(16);
+    }
+  }
+
+  if (traceFile && !Tracer::get().save(traceFile)) {
+    std::cerr << std::endl
+              << "Error:  Unable to create " << traceFile << "." << std::endl;
+    exit(16);
+  }
 
   return 0;
 }
\ No newline at end of file
@@ -1,18 +1,21 @@
 #include "mesh.h"
+#include "telemetry.h"
+#include "tracing.h"
 #include <cassert>
+#include <parallel/algorithm>
 
 /******************************************************************************/
 /* Vertex */
 
-Vertex::Vertex(const int id, const double x, const double y, const double z) {
+Vertex::Vertex(const Index id, const double x, const double y,
+               const double z) {
   this->id = id;
   this->x = x;
   this->y = y;
   this->z = z;
   this->removed = false;
-  this->neighbourVertices.insert(this);
 
-  memset(this->Q, 0, sizeof(double) * 16);
+  memset(this->Q, 0, sizeof(Quadric));
 }
 
 Vertex::Vertex(Vertex &v) {
@@ -22,7 +25,7 @@ Vertex::Vertex(Vertex &v) {
   this->z = v.z;
   this->removed = v.removed;
 
-  memcpy(this->Q, v.Q, sizeof(double) * 16);
+  memcpy(this->Q, v.Q, sizeof(Quadric));
 }
 
 bool Vertex::operator<(Vertex &v) { return this->id < v.id; }
@@ -31,29 +34,35 @@ bool Vertex::operator>(Vertex &v) { return this->id > v.id; }
 
 bool Vertex::operator==(Vertex &v) { return this->id == v.id; }
 
-int Vertex::getId() const { return this->id; }
+Index Vertex::getId() const { return this->id; }
 
-double Vertex::getX() const { return this->x; }
+Scalar Vertex::getX() const { return this->x; }
 
-double Vertex::getY() const { return this->y; }
+Scalar Vertex::getY() const { return this->y; }
 
-double Vertex::getZ() const { return this->z; }
+Scalar Vertex::getZ() const { return this->z; }
 
-const std::set<Vertex *> &Vertex::getNeighbourVertices() const {
+const VertexList &Vertex::getNeighbourVertices() const {
   return this->neighbourVertices;
 }
 
-const std::set<Face *> &Vertex::getFaces() const { return this->faces; }
+const FaceList &Vertex::getFaces() const { return this->faces; }
 
-const std::set<Edge *> &Vertex::getOutgoingEdges() const {
+const EdgeList &Vertex::getOutgoingEdges() const {
   return this->outgoingEdges;
 }
 
-const std::set<Edge *> &Vertex::getIncomingEdges() const {
+const EdgeList &Vertex::getIncomingEdges() const {
   return this->incomingEdges;
 }
 
-void Vertex::setId(int id) { this->id = id; }
+void Vertex::setId(Index id) { this->id = id; }
+
+void Vertex::setPosition(const double x, const double y, const double z) {
+  this->x = x;
+  this->y = y;
+  this->z = z;
+}
 
 void Vertex::addFace(Face *f) { this->faces.insert(f); }
 
@@ -67,13 +76,6 @@ void Vertex::addIncomingEdge(Edge *e) {
   this->incomingEdges.insert(e);
 }
 
-void Vertex::update(const Vertex *v) {
-  this->x = v->x;
-  this->y = v->y;
-  this->z = v->z;
-  memcpy(this->Q, v->Q, sizeof(double) * 16);
-}
-
 void Vertex::remove() {
   if (this->removed) {
     return;
@@ -86,17 +88,20 @@ void Vertex::remove() {
   this->removed = true;
 }
 
+void Vertex::replaceNeighbour(Vertex *from, Vertex *to) {
+  this->neighbourVertices.erase(from);
+  this->neighbourVertices.insert(to);
+}
+
 void Vertex::removeFace(Face *f) { this->faces.erase(f); }
 
 void Vertex::removeOutgoingEdge(Edge *e) {
-  this->neighbourVertices.erase((Vertex *)e->getV1());
   this->neighbourVertices.erase((Vertex *)e->getV2());
   this->outgoingEdges.erase(e);
 }
 
 void Vertex::removeIncomingEdge(Edge *e) {
   this->neighbourVertices.erase((Vertex *)e->getV1());
-  this->neighbourVertices.erase((Vertex *)e->getV2());
   this->incomingEdges.erase(e);
 }
 
@@ -122,14 +127,20 @@ Edge *Vertex::getEdgeWithMinCost() const {
   return edgeWithMinCost;
 }
 
+size_t Vertex::getMemoryUsage() const {
+  return sizeof(Vertex) + this->neighbourVertices.getHeapBytes() +
+         this->faces.getHeapBytes() + this->outgoingEdges.getHeapBytes() +
+         this->incomingEdges.getHeapBytes();
+}
+
 /******************************************************************************/
 /* Face */
 
-Face::Face(const int id, const int noOfVertices) {
+Face::Face(const Index id, Vertex *v1, Vertex *v2, Vertex *v3) {
   this->id = id;
-  this->noOfVertices = noOfVertices;
   this->removed = false;
-  this->vertices.reserve(noOfVertices);
+  this->vertices = {v1, v2, v3};
+  this->edges.fill(NULL);
 }
 
 bool Face::operator<(Face &f) { return this->id < f.id; }
@@ -138,27 +149,43 @@ bool Face::operator>(Face &f) { return this->id > f.id; }
 
 bool Face::operator==(Face &f) { return this->id == f.id; }
 
-int Face::getId() const { return this->id; }
+Index Face::getId() const { return this->id; }
 
-int Face::getNoOfVertices() const { return this->noOfVertices; }
+int Face::getNoOfVertices() const { return NO_OF_VERTICES; }
 
 const Vertex *Face::getVertex(int id) const {
-  return id < this->noOfVertices ? this->vertices[id] : NULL;
+  return id < NO_OF_VERTICES ? this->vertices[id] : NULL;
 }
-const std::vector<Vertex *> &Face::getVertices() const {
+const std::array<Vertex *, 3> &Face::getVertices() const {
   return this->vertices;
 }
 
-const std::set<Edge *> &Face::getEdges() const { return this->edges; }
+const std::array<Edge *, 3> &Face::getEdges() const { return this->edges; }
 
-void Face::setVertex(int id, Vertex *v) { this->vertices[id] = v; }
+int Face::getNoOfEdges() const {
+  return (this->edges[0] != NULL) + (this->edges[1] != NULL) +
+         (this->edges[2] != NULL);
+}
 
-void Face::addVertex(Vertex *v) { this->vertices.push_back(v); }
+void Face::setVertex(int id, Vertex *v) { this->vertices[id] = v; }
 
-void Face::addEdge(Edge *e) { this->edges.insert(e); }
+void Face::addEdge(Edge *e) {
+  Edge **slot = NULL;
+  for (Edge *&fe : this->edges) {
+    if (fe == e) {
+      return;
+    }
+    if (!fe && !slot) {
+      slot = &fe;
+    }
+  }
+  if (slot) {
+    *slot = e;
+  }
+}
 
 void Face::replaceVertex(Vertex *v1, Vertex *v2) {
-  for (int i = 0; i < this->getNoOfVertices(); i++) {
+  for (int i = 0; i < NO_OF_VERTICES; i++) {
     if (this->vertices[i] == v1) {
       this->vertices[i] = v2;
     }
@@ -174,44 +201,48 @@ void Face::remove() {
   for (Vertex *v : this->vertices) {
     v->removeFace(this);
   }
-  this->vertices.clear();
 
   // Remove this face from all its associated edges
-  for (Edge *e : this->edges) {
-    e->removeFace(this);
+  for (Edge *&e : this->edges) {
+    if (e) {
+      e->removeFace(this);
+      e = NULL;
+    }
   }
-  this->edges.clear();
 
   this->removed = true;
 }
 
-void Face::removeEdge(Edge *e) { this->edges.erase(e); }
+void Face::removeEdge(Edge *e) {
+  for (Edge *&fe : this->edges) {
+    if (fe == e) {
+      fe = NULL;
+    }
+  }
+}
 
 bool Face::isRemoved() const { return this->removed; }
 
-bool Face::isValid() const { return vertices.size() > 0; }
+bool Face::isValid() const { return !this->removed; }
 
 /******************************************************************************/
 /* Edge */
 
 void Edge::updatePlacement() {
-  if (this->placement) {
-    delete this->placement;
-  }
   assert(v1 && v2);
-  this->placement =
-      new Vertex(0, (v1->getX() + v2->getX()) / 2,
-                 (v1->getY() + v2->getY()) / 2, (v1->getZ() + v2->getZ()) / 2);
+  this->setPlacement((v1->getX() + v2->getX()) / 2,
+                     (v1->getY() + v2->getY()) / 2,
+                     (v1->getZ() + v2->getZ()) / 2);
 }
 
-Edge::Edge(const int id, Vertex *v1, Vertex *v2) {
+Edge::Edge(const Index id, Vertex *v1, Vertex *v2) {
   this->id = id;
   this->v1 = v1;
   this->v2 = v2;
   this->removed = false;
   this->modified = false;
   this->cost = 0.0;
-  this->placement = NULL;
+  this->faces.fill(NULL);
   updatePlacement();
 }
 
@@ -221,7 +252,7 @@ bool Edge::operator>(Edge &e) { return this->id > e.id; }
 
 bool Edge::operator==(Edge &e) { return this->id == e.id; }
 
-int Edge::getId() const { return this->id; }
+Index Edge::getId() const { return this->id; }
 
 const Vertex *Edge::getV1() const { return this->v1; }
 
@@ -229,9 +260,9 @@ const Vertex *Edge::getV2() const { return this->v2; }
 
 const double Edge::getCost() const { return this->cost; }
 
-const Vertex *Edge::getPlacement() const { return this->placement; }
+const Scalar *Edge::getPlacement() const { return this->placement; }
 
-const std::set<Face *> &Edge::getFaces() const { return this->faces; }
+const std::array<Face *, 2> &Edge::getFaces() const { return this->faces; }
 
 void Edge::setV1(Vertex *v) {
   this->v1 = v;
@@ -245,7 +276,24 @@ void Edge::setV2(Vertex *v) {
 
 void Edge::setCost(double c) { this->cost = c; }
 
-void Edge::addFace(Face *f) { this->faces.insert(f); }
+void Edge::setPlacement(const double x, const double y, const double z) {
+  this->placement[0] = x;
+  this->placement[1] = y;
+  this->placement[2] = z;
+}
+
+bool Edge::addFace(Face *f) {
+  if (this->faces[0] == f || this->faces[1] == f) {
+    return true;
+  }
+  for (Face *&ef : this->faces) {
+    if (!ef) {
+      ef = f;
+      return true;
+    }
+  }
+  return false;
+}
 
 void Edge::modifiy() { this->modified = true; }
 
@@ -261,15 +309,23 @@ void Edge::remove() {
   this->v2->removeIncomingEdge(this);
 
   // Remove this edge from all its associated faces
-  for (Face *f : this->faces) {
-    f->removeEdge(this);
+  for (Face *&f : this->faces) {
+    if (f) {
+      f->removeEdge(this);
+      f = NULL;
+    }
   }
-  this->faces.clear();
 
   this->removed = true;
 }
 
-void Edge::removeFace(Face *f) { this->faces.erase(f); }
+void Edge::removeFace(Face *f) {
+  for (Face *&ef : this->faces) {
+    if (ef == f) {
+      ef = NULL;
+    }
+  }
+}
 
 bool Edge::isRemoved() const { return this->removed; }
 
@@ -281,11 +337,17 @@ Volume::Volume() {
   this->minY = DBL_MAX;
   this->minZ = DBL_MAX;
 
-  this->maxX = DBL_MIN;
-  this->maxY = DBL_MIN;
-  this->maxZ = DBL_MIN;
+  this->maxX = -DBL_MAX;
+  this->maxY = -DBL_MAX;
+  this->maxZ = -DBL_MAX;
 }
 
+double Volume::getMinX() const { return minX; }
+
+double Volume::getMinY() const { return minY; }
+
+double Volume::getMinZ() const { return minZ; }
+
 double Volume::getXDim() const { return maxX - minX; }
 
 double Volume::getYDim() const { return maxY - minY; }
@@ -319,12 +381,41 @@ void Volume::setMax(double x, double y, double z) {
 /******************************************************************************/
 /* Mesh */
 
+/*
+  Vertex, face and edge counts of the OFF header; false if they are missing.
+  Counts beyond the index width are fatal, so they cannot wrap into a mesh
+  that only looks valid.
+*/
+bool Mesh::readCounts(const FILE *file) {
+  long long counts[3];
+  if (fscanf((FILE *)file, "%lld %lld %lld\n", &counts[0], &counts[1],
+             &counts[2]) != 3 ||
+      counts[0] < 0 || counts[1] < 0) {
+    return false;
+  }
+  if (counts[0] > MAX_INDEX || counts[1] > MAX_INDEX) {
+    std::cerr << std::endl
+              << "Error:  The mesh has more vertices or faces than "
+              << MAX_INDEX << ", the most " << 8 * sizeof(Index)
+              << "-bit ids can hold. Rebuild with make INDEX64=1."
+              << std::endl;
+    exit(18);
+  }
+
+  this->noOfVertices = counts[0];
+  this->noOfFaces = counts[1];
+  this->noOfEdges = std::min(std::max(counts[2], 0LL), (long long)MAX_INDEX);
+  return true;
+}
+
 void Mesh::readVertices(const FILE *file) {
+  TRACE_SCOPE("read-vertices");
   std::cout << "Reading vertices... ";
 
   FILE *f = (FILE *)file;
   double x, y, z;
-  for (int i = 0; i < this->noOfVertices; i++) {
+  this->vertexArena.reserve(this->noOfVertices);
+  for (Index i = 0; i < this->noOfVertices; i++) {
     if (fscanf(f, "%lf %lf %lf\n", &x, &y, &z) != 3) {
       std::cout << "Failed!" << std::endl;
       std::cerr << std::endl
@@ -339,19 +430,26 @@ void Mesh::readVertices(const FILE *file) {
 
     this->volume.setMin(x, y, z);
     this->volume.setMax(x, y, z);
-    this->vertices.push_back(new Vertex(i, x, y, z));
+    this->vertices.push_back(this->vertexArena.create(i, x, y, z));
   }
 
   std::cout << "Done" << std::endl;
 }
 
 void Mesh::readFaces(const FILE *file) {
+  TRACE_SCOPE("read-faces");
   std::cout << "Reading faces... ";
 
   FILE *f = (FILE *)file;
-  int nv, v1, v2, v3;
-  for (int i = 0; i < this->noOfFaces; i++) {
-    if (fscanf(f, "%d %d %d %d\n", &nv, &v1, &v2, &v3) != 4) {
+  Index noOfPolygons = 0;
+  std::vector<long long> polygon;
+  this->faceArena.reserve(this->noOfFaces);
+  for (Index i = 0; i < this->noOfFaces; i++) {
+    bool valid = readPolygon(f, polygon);
+    for (int j = 0; valid && j < (int)polygon.size(); j++) {
+      valid = polygon[j] >= 0 && polygon[j] < this->noOfVertices;
+    }
+    if (!valid) {
       std::cout << "Failed!" << std::endl;
       std::cerr << std::endl
                 << "Error:  Invalid input "
@@ -362,57 +460,91 @@ void Mesh::readFaces(const FILE *file) {
                 << std::endl;
       exit(15);
     }
+    int nv = polygon.size();
 
-    Face *face = new Face(i, nv);
-    face->addVertex(this->vertices.at(v1));
-    face->addVertex(this->vertices.at(v2));
-    face->addVertex(this->vertices.at(v3));
-
-    this->vertices.at(v1)->addFace(face);
-    this->vertices.at(v2)->addFace(face);
-    this->vertices.at(v3)->addFace(face);
+    // Polygons are fanned around their first vertex
+    noOfPolygons += nv > 3;
+    if ((long long)this->faces.size() + nv - 2 > MAX_INDEX) {
+      std::cout << "Failed!" << std::endl;
+      std::cerr << std::endl
+                << "Error:  The mesh has more triangles than " << MAX_INDEX
+                << ", the most " << 8 * sizeof(Index)
+                << "-bit ids can hold. Rebuild with make INDEX64=1."
+                << std::endl;
+      exit(18);
+    }
+    for (int j = 1; j + 1 < nv; j++) {
+      this->createFace(this->vertices[polygon[0]], this->vertices[polygon[j]],
+                       this->vertices[polygon[j + 1]]);
+    }
+  }
+  this->noOfFaces = this->faces.size();
 
-    this->faces.push_back(face);
+  std::cout << "Done";
+  if (noOfPolygons) {
+    std::cout << " [" << noOfPolygons << " polygon(s) triangulated]";
   }
+  std::cout << std::endl;
+}
 
-  std::cout << "Done" << std::endl;
+bool Mesh::readPolygon(FILE *file, std::vector<long long> &polygon) {
+  int nv;
+  bool valid = fscanf(file, "%d", &nv) == 1 && nv >= 3;
+  polygon.resize(valid ? nv : 0);
+  for (int j = 0; valid && j < nv; j++) {
+    valid = fscanf(file, "%lld", &polygon[j]) == 1;
+  }
+  if (!valid) {
+    return false;
+  }
+  // Anything after the indices, such as a face color, is skipped
+  for (int c = fgetc(file); c != '\n' && c != EOF; c = fgetc(file)) {
+  }
+  return true;
 }
 
-void Mesh::readEdges(const FILE *file) {
+void Mesh::readEdges() {
+  TRACE_SCOPE("read-edges");
   std::cout << "Populating edges... ";
 
-  std::vector<Vertex *> vertices;
-  vertices.reserve(3);
-
   int map[3][2] = {{0, 1}, {0, 2}, {1, 2}};
 
-  int eid = 0;
+  Index eid = 0;
+  Index noOfExtraFaces = 0;
+  // Closed manifold meshes have 3/2 edges per face
+  this->edgeArena.reserve(this->faces.size() * 3 / 2 + 1);
   for (Face *face : this->faces) {
-    vertices.clear();
-    for (int i = 0; i < face->getNoOfVertices(); i++) {
-      vertices.push_back((Vertex *)face->getVertex(i));
-    }
+    std::array<Vertex *, 3> vertices = face->getVertices();
     std::sort(vertices.begin(), vertices.end());
 
     for (int i = 0; i < 3; i++) {
       Vertex *v1 = vertices[map[i][0]];
       Vertex *v2 = vertices[map[i][1]];
 
-      const std::set<Edge *> &v1OutgoingEdges = v1->getOutgoingEdges();
+      const EdgeList &v1OutgoingEdges = v1->getOutgoingEdges();
 
       Edge *e = NULL;
       for (Edge *oe : v1OutgoingEdges) {
         if (oe->getV2() == v2) {
           e = oe;
           // Edge already exists, add this face to the edge
-          e->addFace(face);
+          noOfExtraFaces += !e->addFace(face);
           face->addEdge(e);
         }
       }
 
       if (!e) {
         // Edge does not exist
-        Edge *e = new Edge(eid, v1, v2);
+        if (eid == MAX_INDEX) {
+          std::cout << "Failed!" << std::endl;
+          std::cerr << std::endl
+                    << "Error:  The mesh has more edges than " << MAX_INDEX
+                    << ", the most " << 8 * sizeof(Index)
+                    << "-bit ids can hold. Rebuild with make INDEX64=1."
+                    << std::endl;
+          exit(18);
+        }
+        Edge *e = this->edgeArena.create(eid, v1, v2);
         e->addFace(face);
 
         v1->addOutgoingEdge(e);
@@ -429,10 +561,183 @@ void Mesh::readEdges(const FILE *file) {
 
   this->noOfEdges = eid;
 
+  std::cout << "Done";
+  if (noOfExtraFaces) {
+    std::cout << " [" << noOfExtraFaces
+              << " extra face(s) on non-manifold edges]";
+  }
+  std::cout << std::endl;
+}
+
+/*
+  Renumber the vertices in the order of <curve> through the mesh volume, and
+  the faces by their smallest vertex, then reallocate both in that order so
+  that neighbourhoods are also close in memory. Runs before readEdges(), so
+  faces are the only adjacency to rebuild.
+*/
+void Mesh::reorder(SpaceFillingCurve::Curve curve) {
+  ScopedPhase phase("reorder");
+  TRACE_SCOPE("reorder");
+  std::cout << "Reordering along the "
+            << (curve == SpaceFillingCurve::HILBERT ? "Hilbert" : "Morton")
+            << " curve... ";
+
+  std::vector<Index> order = this->getCurveOrder(curve);
+  Index noOfVertices = order.size();
+
+  std::vector<Index> id(noOfVertices);
+  std::vector<Vertex *> vertices(noOfVertices);
+  Arena<Vertex> vertexArena;
+  vertexArena.reserve(noOfVertices);
+  for (Index i = 0; i < noOfVertices; i++) {
+    const Vertex *v = this->vertices[order[i]];
+    id[order[i]] = i;
+    vertices[i] = vertexArena.create(i, v->getX(), v->getY(), v->getZ());
+  }
+
+  // Smallest vertex first, then the vertices in their original winding
+  Index noOfFaces = this->faces.size();
+  std::vector<std::array<Index, 4>> faces(noOfFaces);
+#pragma omp parallel for
+  for (Index i = 0; i < noOfFaces; i++) {
+    Index v1 = id[this->faces[i]->getVertex(0)->getId()];
+    Index v2 = id[this->faces[i]->getVertex(1)->getId()];
+    Index v3 = id[this->faces[i]->getVertex(2)->getId()];
+    faces[i] = {std::min({v1, v2, v3}), v1, v2, v3};
+  }
+  __gnu_parallel::sort(faces.begin(), faces.end());
+
+  // The old objects are released with the local arenas, after the new ones
+  // have been laid out in their own chunks
+  Arena<Face> faceArena;
+  this->vertexArena.swap(vertexArena);
+  this->faceArena.swap(faceArena);
+  this->vertices.swap(vertices);
+  this->faces.clear();
+  this->faceArena.reserve(noOfFaces);
+  for (const std::array<Index, 4> &f : faces) {
+    this->createFace(this->vertices[f[1]], this->vertices[f[2]],
+                     this->vertices[f[3]]);
+  }
+
   std::cout << "Done" << std::endl;
 }
 
-void Mesh::read(const char *inputFile) {
+void Mesh::cluster(const std::vector<Index> &clusters,
+                   const std::vector<Scalar> &positions) {
+  TRACE_SCOPE("cluster");
+  Index noOfClusters = positions.size() / 3;
+
+  std::vector<Vertex *> vertices(noOfClusters);
+  Arena<Vertex> vertexArena;
+  vertexArena.reserve(noOfClusters);
+  for (Index c = 0; c < noOfClusters; c++) {
+    vertices[c] = vertexArena.create(c, positions[3 * c],
+                                     positions[3 * c + 1],
+                                     positions[3 * c + 2]);
+  }
+
+  std::vector<char> hadFaces(noOfClusters, 0);
+  for (Index i = 0; i < (Index)this->vertices.size(); i++) {
+    assert(clusters[i] >= 0 || this->vertices[i]->isRemoved());
+    if (clusters[i] >= 0) {
+      hadFaces[clusters[i]] |= this->vertices[i]->hasFaces();
+    }
+  }
+
+  // Live faces in cluster ids, and their sorted ids followed by the face
+  // index, so that sorting those puts the first of duplicates first
+  Index noOfFaces = this->faces.size();
+  std::vector<std::array<Index, 3>> faces(noOfFaces);
+  std::vector<std::array<Index, 4>> keys;
+  keys.reserve(noOfFaces);
+  for (Index i = 0; i < noOfFaces; i++) {
+    const Face *f = this->faces[i];
+    if (f->isRemoved()) {
+      continue;
+    }
+    for (int j = 0; j < 3; j++) {
+      faces[i][j] = clusters[f->getVertex(j)->getId()];
+    }
+    std::array<Index, 3> v = faces[i];
+    std::sort(v.begin(), v.end());
+    if (v[0] != v[1] && v[1] != v[2]) {
+      keys.push_back({v[0], v[1], v[2], i});
+    }
+  }
+  __gnu_parallel::sort(keys.begin(), keys.end());
+
+  std::vector<char> kept(noOfFaces, 0);
+  for (Index k = 0; k < (Index)keys.size(); k++) {
+    kept[keys[k][3]] = k == 0 || keys[k][0] != keys[k - 1][0] ||
+                       keys[k][1] != keys[k - 1][1] ||
+                       keys[k][2] != keys[k - 1][2];
+  }
+
+  // The old objects are released with the local arenas, as in reorder()
+  Arena<Face> faceArena;
+  Arena<Edge> edgeArena;
+  this->vertexArena.swap(vertexArena);
+  this->faceArena.swap(faceArena);
+  this->edgeArena.swap(edgeArena);
+  this->vertices.swap(vertices);
+  this->faces.clear();
+  this->edges.clear();
+  this->faceArena.reserve(keys.size());
+  for (Index i = 0; i < noOfFaces; i++) {
+    if (kept[i]) {
+      this->createFace(this->vertices[faces[i][0]],
+                       this->vertices[faces[i][1]],
+                       this->vertices[faces[i][2]]);
+    }
+  }
+  for (Index c = 0; c < noOfClusters; c++) {
+    if (hadFaces[c] && !this->vertices[c]->hasFaces()) {
+      this->vertices[c]->remove();
+    }
+  }
+  this->noOfVertices = noOfClusters;
+  this->noOfFaces = this->faces.size();
+
+  this->readEdges();
+}
+
+std::vector<Index>
+Mesh::getCurveOrder(SpaceFillingCurve::Curve curve) const {
+  const Volume &volume = this->volume;
+  double dimX = volume.getXDim();
+  double dimY = volume.getYDim();
+  double dimZ = volume.getZDim();
+  Index noOfVertices = this->vertices.size();
+  std::vector<std::pair<uint64_t, Index>> keys(noOfVertices);
+#pragma omp parallel for
+  for (Index i = 0; i < noOfVertices; i++) {
+    const Vertex *v = this->vertices[i];
+    double x = dimX > 0 ? (v->getX() - volume.getMinX()) / dimX : 0;
+    double y = dimY > 0 ? (v->getY() - volume.getMinY()) / dimY : 0;
+    double z = dimZ > 0 ? (v->getZ() - volume.getMinZ()) / dimZ : 0;
+    keys[i] = {SpaceFillingCurve::encode(curve, x, y, z), i};
+  }
+  __gnu_parallel::sort(keys.begin(), keys.end());
+
+  std::vector<Index> order(noOfVertices);
+#pragma omp parallel for
+  for (Index i = 0; i < noOfVertices; i++) {
+    order[i] = keys[i].second;
+  }
+  return order;
+}
+
+Face *Mesh::createFace(Vertex *v1, Vertex *v2, Vertex *v3) {
+  Face *face = this->faceArena.create(this->faces.size(), v1, v2, v3);
+  v1->addFace(face);
+  v2->addFace(face);
+  v3->addFace(face);
+  this->faces.push_back(face);
+  return face;
+}
+
+void Mesh::read(const char *inputFile, SpaceFillingCurve::Curve curve) {
   int rv;
   char buffer[256];
 
@@ -459,9 +764,7 @@ void Mesh::read(const char *inputFile) {
     exit(12);
   }
 
-  rv = fscanf(file, "%d %d %d\n", &this->noOfVertices, &this->noOfFaces,
-              &this->noOfEdges);
-  if (rv != 3) {
+  if (!this->readCounts(file)) {
     std::cerr << std::endl
               << "Error:  Invalid input file "
                  "format. Only OFF (Object "
@@ -475,12 +778,17 @@ void Mesh::read(const char *inputFile) {
   std::cout << std::endl;
   this->readVertices(file);
   this->readFaces(file);
-  this->readEdges(file);
+  if (curve != SpaceFillingCurve::NONE) {
+    this->reorder(curve);
+  }
+  this->readEdges();
 
   std::cout << std::endl;
   std::cout << "Number Of Vertex(s) : " << this->noOfVertices << std::endl;
   std::cout << "Number Of Face(s)   : " << this->noOfFaces << std::endl;
   std::cout << "Number Of Edge(s)   : " << this->noOfEdges << std::endl;
+  std::cout << "Vertex Memory       : " << this->getVertexMemoryUsage()
+            << " byte(s)/vertex" << std::endl;
 
   std::cout << std::endl;
   std::cout << "Volume Dimensions   : [" << this->volume.getXDim() << ", "
@@ -514,10 +822,10 @@ void Mesh::write(const char *inputFile) {
       this->faces.end());
 
   fprintf(file, "OFF\n");
-  fprintf(file, "%d %d %d\n", (int)this->vertices.size(),
-          (int)this->faces.size(), 0);
+  fprintf(file, "%lld %lld %d\n", (long long)this->vertices.size(),
+          (long long)this->faces.size(), 0);
 
-  for (int i = 0; i < this->vertices.size(); i++) {
+  for (Index i = 0; i < (Index)this->vertices.size(); i++) {
     Vertex *v = this->vertices[i];
     if (v != NULL) {
       v->setId(i);
@@ -525,14 +833,15 @@ void Mesh::write(const char *inputFile) {
     }
   }
 
-  for (int i = 0; i < this->faces.size(); i++) {
+  for (Index i = 0; i < (Index)this->faces.size(); i++) {
     Face *f = this->faces[i];
-    if (f != NULL && f->getVertices().size() == 3) {
+    if (f != NULL) {
       const Vertex *v1 = f->getVertex(0);
       const Vertex *v2 = f->getVertex(1);
       const Vertex *v3 = f->getVertex(2);
-      fprintf(file, "%d %d %d %d\n", f->getNoOfVertices(), v1->getId(),
-              v2->getId(), v3->getId());
+      fprintf(file, "%d %lld %lld %lld\n", f->getNoOfVertices(),
+              (long long)v1->getId(), (long long)v2->getId(),
+              (long long)v3->getId());
     }
   }
 
@@ -541,13 +850,44 @@ void Mesh::write(const char *inputFile) {
   std::cout << "Done" << std::endl;
 }
 
-Mesh::Mesh(const char *inputFile) { read(inputFile); }
+Mesh::Mesh() {
+  this->noOfVertices = 0;
+  this->noOfFaces = 0;
+  this->noOfEdges = 0;
+}
+
+Mesh::Mesh(const char *inputFile, SpaceFillingCurve::Curve curve) {
+  read(inputFile, curve);
+}
 
-const int Mesh::getNoOfVertices() const { return this->noOfVertices; }
+// Vertices, faces and edges go with their arenas
+Mesh::~Mesh() {}
 
-const int Mesh::Mesh::getNoOfFaces() const { return this->noOfFaces; }
+const Index Mesh::getNoOfVertices() const { return this->noOfVertices; }
 
-const int Mesh::getNoOfEdges() const { return this->noOfEdges; }
+const Index Mesh::Mesh::getNoOfFaces() const { return this->noOfFaces; }
+
+const Index Mesh::getNoOfEdges() const { return this->noOfEdges; }
+
+const Index Mesh::getNoOfActiveVertices() const {
+  Index count = 0;
+  for (Vertex *v : this->vertices) {
+    if (!v->isRemoved()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+const double Mesh::getVertexMemoryUsage() const {
+  size_t bytes = 0;
+  for (Vertex *v : this->vertices) {
+    bytes += v->getMemoryUsage();
+  }
+  return this->vertices.empty() ? 0.0 : (double)bytes / this->vertices.size();
+}
+
+const Volume &Mesh::getVolume() const { return this->volume; }
 
 const std::vector<Vertex *> &Mesh::getVertices() const {
   return this->vertices;
@@ -557,4 +897,181 @@ const std::vector<Face *> &Mesh::getFaces() const { return this->faces; }
 
 const std::vector<Edge *> &Mesh::getEdges() const { return this->edges; }
 
-void Mesh::saveAsOFF(const char *outputFile) { this->write(outputFile); }
\ No newline at end of file
+/*
+  Merge v1 of <edge> into v2, which moves to <placement>. The faces around the
+  edge are removed and appended to <removedFaces>; edges of v1 that duplicate
+  an edge of v2 are removed and the others are moved over to v2. Returns false
+  without changing anything if the edge or an end point is already removed or
+  out of faces. Connectivity only: quadrics and costs are left to the caller.
+*/
+bool Mesh::collapseEdge(Edge *edge, const Scalar placement[3],
+                        std::vector<Face *> &removedFaces) {
+  Vertex *v1 = (Vertex *)edge->getV1();
+  Vertex *v2 = (Vertex *)edge->getV2();
+  assert(v1 && v2);
+
+  if (edge->isRemoved() || v1->isRemoved() || v2->isRemoved()) {
+    return false;
+  }
+  if (!v1->hasFaces() || !v2->hasFaces()) {
+    return false;
+  }
+
+  // ---------------------------------------------------------------------------
+  /* Remove faces associated with the collapsed edge */
+  // Found through the vertices rather than edge->getFaces(): the face sets of
+  // edges that were redirected by earlier collapses can be incomplete, which
+  // left degenerate faces behind
+  int first = removedFaces.size();
+  for (Face *f : v1->getFaces()) {
+    const std::array<Vertex *, 3> &fv = f->getVertices();
+    if (std::find(fv.begin(), fv.end(), v2) != fv.end()) {
+      removedFaces.push_back(f);
+    }
+  }
+  for (int i = first; i < (int)removedFaces.size(); i++) {
+    removedFaces[i]->remove();
+  }
+
+  // ---------------------------------------------------------------------------
+  /* Remove the collapsed edge */
+  edge->remove();
+
+  // ---------------------------------------------------------------------------
+  /* Move the v2 vertex to the placement */
+  v2->setPosition(placement[0], placement[1], placement[2]);
+
+  // ---------------------------------------------------------------------------
+  /* Update all edges of the v1 vertex */
+  // Edges of v2 are looked up in its adjacency lists, which at typical
+  // valence is cheaper than building a map of them
+  auto findEdge = [v2](const Vertex *v) -> Edge * {
+    for (Edge *ie : v2->getIncomingEdges()) {
+      if (ie->getV1() == v) {
+        return ie;
+      }
+    }
+    for (Edge *oe : v2->getOutgoingEdges()) {
+      if (oe->getV2() == v) {
+        return oe;
+      }
+    }
+    return NULL;
+  };
+
+  // Update the edge->v2 vertex to v2 for all incoming edges of v1, and add the
+  // edge to v2
+  // Edges of v1 that duplicate an edge of v2 are removed once the lists are
+  // no longer being iterated
+  EdgeList duplicateEdges;
+  for (Edge *ie : v1->getIncomingEdges()) {
+    assert(ie && ie != edge);
+
+    Vertex *u = (Vertex *)ie->getV1();
+    if (findEdge(u)) {
+      duplicateEdges.push_back(ie);
+    } else {
+      ie->setV2(v2);
+      v2->addIncomingEdge(ie);
+      u->replaceNeighbour(v1, v2);
+    }
+  }
+
+  // Update the edge->v1 vertex to v2 for all outgoing edges of v1, and add
+  // the edge to v2
+  for (Edge *oe : v1->getOutgoingEdges()) {
+    assert(oe && oe != edge);
+
+    Vertex *u = (Vertex *)oe->getV2();
+    if (findEdge(u)) {
+      duplicateEdges.push_back(oe);
+    } else {
+      oe->setV1(v2);
+      v2->addOutgoingEdge(oe);
+      u->replaceNeighbour(v1, v2);
+    }
+  }
+  for (Edge *de : duplicateEdges) {
+    de->remove();
+  }
+
+  // ---------------------------------------------------------------------------
+  /* Update all faces of the v1 vertex */
+
+  for (Face *f : v1->getFaces()) {
+    if (f->getNoOfEdges() == 2) {
+      for (Vertex *v : f->getVertices()) {
+        Edge *e = findEdge(v);
+        if (e) {
+          f->addEdge(e);
+        }
+      }
+    }
+    f->replaceVertex(v1, v2);
+    v2->addFace(f);
+  }
+
+  // ---------------------------------------------------------------------------
+  /* Remove v1 vertex */
+  v1->remove();
+  return true;
+}
+
+MeshSnapshot Mesh::snapshot() const {
+  MeshSnapshot snapshot;
+
+  // Vertex ids are still input indices here; write() has not renumbered them
+  std::vector<Index> id(this->vertices.size(), -1);
+  Index noOfLiveVertices = 0;
+  for (const Vertex *v : this->vertices) {
+    if (!v->isRemoved()) {
+      id[v->getId()] = noOfLiveVertices++;
+      snapshot.vertices.push_back(v->getX());
+      snapshot.vertices.push_back(v->getY());
+      snapshot.vertices.push_back(v->getZ());
+    }
+  }
+
+  for (const Face *f : this->faces) {
+    if (!f->isRemoved()) {
+      for (int i = 0; i < 3; i++) {
+        snapshot.faces.push_back(id[f->getVertex(i)->getId()]);
+      }
+    }
+  }
+
+  return snapshot;
+}
+
+void Mesh::saveAsOFF(const char *outputFile) { this->write(outputFile); }
+
+/******************************************************************************/
+
+Index MeshSnapshot::getNoOfVertices() const {
+  return this->vertices.size() / 3;
+}
+
+Index MeshSnapshot::getNoOfFaces() const { return this->faces.size() / 3; }
+
+bool MeshSnapshot::saveAsOFF(const char *outputFile) const {
+  FILE *file = fopen(outputFile, "w");
+  if (!file) {
+    return false;
+  }
+
+  fprintf(file, "OFF\n");
+  fprintf(file, "%lld %lld %d\n", (long long)getNoOfVertices(),
+          (long long)getNoOfFaces(), 0);
+
+  for (size_t i = 0; i < this->vertices.size(); i += 3) {
+    fprintf(file, "%lf %lf %lf\n", this->vertices[i], this->vertices[i + 1],
+            this->vertices[i + 2]);
+  }
+
+  for (size_t i = 0; i < this->faces.size(); i += 3) {
+    fprintf(file, "%d %lld %lld %lld\n", 3, (long long)this->faces[i],
+            (long long)this->faces[i + 1], (long long)this->faces[i + 2]);
+  }
+
+  return fclose(file) == 0;
+}
\ No newline at end of file
@@ -1,60 +1,71 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <float.h>
 #include <fstream>
 #include <iostream>
-#include <set>
 #include <vector>
 
+#include "arena.h"
+#include "index.h"
+#include "precision.h"
+#include "sfc.h"
+#include "small_vector.h"
+
 class Vertex;
 class Face;
 class Edge;
 class Volume;
 class Mesh;
+class MeshSnapshot;
 
 /******************************************************************************/
 
+typedef SmallVector<Vertex *, 8> VertexList;
+typedef SmallVector<Face *, 8> FaceList;
+typedef SmallVector<Edge *, 4> EdgeList;
+
 class Vertex {
-  int id;
-  double x, y, z;
+  Index id;
+  Scalar x, y, z;
   bool removed;
 
-  std::set<Vertex *> neighbourVertices; // TODO: Cleared
-
-  std::set<Face *> faces; // TODO: Cleared
-
-  std::set<Edge *> outgoingEdges; // from  // TODO: Cleared
-  std::set<Edge *> incomingEdges; // to  // TODO: Cleared
+  // Unordered; sized so a vertex of typical valence does not allocate
+  VertexList neighbourVertices; // excluding this vertex
+  FaceList faces;
+  EdgeList outgoingEdges; // from
+  EdgeList incomingEdges; // to
 
 public:
-  double Q[4][4];
+  Quadric Q;
 
   Vertex() = delete;
-  Vertex(const int, const double, const double, const double);
+  Vertex(const Index, const double, const double, const double);
   Vertex(Vertex &);
 
   bool operator<(Vertex &);
   bool operator>(Vertex &);
   bool operator==(Vertex &);
 
-  int getId() const;
-  double getX() const;
-  double getY() const;
-  double getZ() const;
-  const std::set<Vertex *> &getNeighbourVertices() const;
-  const std::set<Face *> &getFaces() const;
-  const std::set<Edge *> &getOutgoingEdges() const;
-  const std::set<Edge *> &getIncomingEdges() const;
+  Index getId() const;
+  Scalar getX() const;
+  Scalar getY() const;
+  Scalar getZ() const;
+  const VertexList &getNeighbourVertices() const;
+  const FaceList &getFaces() const;
+  const EdgeList &getOutgoingEdges() const;
+  const EdgeList &getIncomingEdges() const;
 
-  void setId(int);
+  void setId(Index);
+  void setPosition(const double, const double, const double);
 
   void addFace(Face *);
   void addOutgoingEdge(Edge *);
   void addIncomingEdge(Edge *);
 
-  void update(const Vertex *);
+  void replaceNeighbour(Vertex *, Vertex *);
 
   void remove();
   void removeFace(Face *);
@@ -64,35 +75,44 @@ public:
 
   bool hasFaces() const;
   Edge *getEdgeWithMinCost() const;
+
+  /* Bytes taken by this vertex, its adjacency lists included */
+  size_t getMemoryUsage() const;
 };
 
 /******************************************************************************/
 
+/*
+  Triangle. Polygons are fanned into triangles when the mesh is read, so every
+  face has exactly three vertices and three edge slots, stored inline. Edge
+  slots are NULL once the edge is removed.
+*/
 class Face {
-  int id;
-  int noOfVertices;
+  Index id;
   bool removed;
 
-  std::vector<Vertex *> vertices; // TODO: Cleared
-  std::set<Edge *> edges;         // TODO: Cleared
+  std::array<Vertex *, 3> vertices;
+  std::array<Edge *, 3> edges;
 
 public:
+  static const int NO_OF_VERTICES = 3;
+
   Face() = delete;
-  Face(const int, const int);
+  Face(const Index, Vertex *, Vertex *, Vertex *);
 
   bool operator<(Face &);
   bool operator>(Face &);
   bool operator==(Face &);
 
-  int getId() const;
+  Index getId() const;
   int getNoOfVertices() const;
   const Vertex *getVertex(int) const;
-  const std::vector<Vertex *> &getVertices() const;
-  const std::set<Edge *> &getEdges() const;
+  const std::array<Vertex *, 3> &getVertices() const;
+  const std::array<Edge *, 3> &getEdges() const;
+  int getNoOfEdges() const;
 
   void setVertex(int, Vertex *);
 
-  void addVertex(Vertex *);
   void addEdge(Edge *);
 
   void replaceVertex(Vertex *, Vertex *);
@@ -105,39 +125,46 @@ public:
 
 /******************************************************************************/
 
+/*
+  Edges have at most two faces on a manifold mesh, kept in inline slots that
+  are NULL when unused. A third face of a non-manifold edge is not recorded
+  on the edge (see addFace()); the face still lists the edge.
+*/
 class Edge {
-  int id;
+  Index id;
   Vertex *v1;
   Vertex *v2;
   bool removed;
   bool modified;
 
   double cost;
-  Vertex *placement;
-  std::set<Face *> faces; // TODO: Cleared
+  Scalar placement[3]; // where v2 goes if the edge is collapsed
+  std::array<Face *, 2> faces;
 
   void updatePlacement();
 
 public:
   Edge() = delete;
-  Edge(const int, Vertex *, Vertex *);
+  Edge(const Index, Vertex *, Vertex *);
 
   bool operator<(Edge &);
   bool operator>(Edge &);
   bool operator==(Edge &);
 
-  int getId() const;
+  Index getId() const;
   const Vertex *getV1() const;
   const Vertex *getV2() const;
   const double getCost() const;
-  const Vertex *getPlacement() const;
-  const std::set<Face *> &getFaces() const;
+  const Scalar *getPlacement() const;
+  const std::array<Face *, 2> &getFaces() const;
 
   void setV1(Vertex *);
   void setV2(Vertex *);
   void setCost(double c);
+  void setPlacement(const double, const double, const double);
 
-  void addFace(Face *);
+  /* Returns false if the edge already has two other faces */
+  bool addFace(Face *);
 
   void modifiy();
   bool isModified() const;
@@ -156,6 +183,9 @@ class Volume {
 public:
   Volume();
 
+  double getMinX() const;
+  double getMinY() const;
+  double getMinZ() const;
   double getXDim() const;
   double getYDim() const;
   double getZDim() const;
@@ -167,33 +197,98 @@ public:
 /******************************************************************************/
 
 class Mesh {
-  int noOfVertices;
-  int noOfFaces;
-  int noOfEdges;
+  Index noOfVertices;
+  Index noOfFaces;
+  Index noOfEdges;
 
   Volume volume;
 
+  // Own the objects the lists below point to
+  Arena<Vertex> vertexArena;
+  Arena<Face> faceArena;
+  Arena<Edge> edgeArena;
+
   std::vector<Vertex *> vertices;
   std::vector<Face *> faces;
   std::vector<Edge *> edges;
 
+  bool readCounts(const FILE *);
   void readVertices(const FILE *);
   void readFaces(const FILE *);
-  void readEdges(const FILE *);
+  void readEdges();
+  void reorder(SpaceFillingCurve::Curve);
+
+  Face *createFace(Vertex *, Vertex *, Vertex *);
 
-  void read(const char *);
+  void read(const char *, SpaceFillingCurve::Curve);
   void write(const char *);
 
+  friend class MeshBenchmarks;
+
 public:
   Mesh();
-  Mesh(const char *inputFile);
-
-  const int getNoOfVertices() const;
-  const int getNoOfFaces() const;
-  const int getNoOfEdges() const;
+  /* <curve> other than NONE renumbers vertices and faces along that curve */
+  Mesh(const char *inputFile,
+       SpaceFillingCurve::Curve curve = SpaceFillingCurve::NONE);
+  ~Mesh();
+
+  const Index getNoOfVertices() const;
+  const Index getNoOfFaces() const;
+  const Index getNoOfEdges() const;
+  const Index getNoOfActiveVertices() const;
+  /* Mean bytes per vertex, adjacency lists included */
+  const double getVertexMemoryUsage() const;
+  const Volume &getVolume() const;
   const std::vector<Vertex *> &getVertices() const;
   const std::vector<Face *> &getFaces() const;
   const std::vector<Edge *> &getEdges() const;
 
+  /* Indices of getVertices() sorted along <curve> through the volume */
+  std::vector<Index> getCurveOrder(SpaceFillingCurve::Curve) const;
+
+  static bool collapseEdge(Edge *, const Scalar placement[3],
+                           std::vector<Face *> &removedFaces);
+
+  /*
+    Vertex clustering: merge every vertex i of getVertices() into new vertex
+    <clusters>[i], at <positions>[3 * <clusters>[i]]; only removed vertices
+    may map to -1. Faces are remapped, dropping those that degenerate or
+    duplicate another, and the edges are rebuilt. Merged vertices left
+    without faces are removed. Connectivity only: quadrics are left to the
+    caller.
+  */
+  void cluster(const std::vector<Index> &clusters,
+               const std::vector<Scalar> &positions);
+
+  /*
+    Read the vertex indices of the next OFF face into <polygon>, skipping
+    anything after them such as a face color. Returns false on a malformed
+    face. Polygons are fanned into the triangles polygon[0], polygon[j],
+    polygon[j + 1], unchecked against the vertex count.
+  */
+  static bool readPolygon(FILE *, std::vector<long long> &polygon);
+
+  MeshSnapshot snapshot() const;
   void saveAsOFF(const char *);
 };
+
+/******************************************************************************/
+
+/*
+  Copy of the live vertices and faces of a mesh, in the order Mesh::write
+  emits them. Taking one leaves the mesh untouched, so simplification can
+  continue while the snapshot is written from another thread.
+*/
+class MeshSnapshot {
+  std::vector<double> vertices;
+  std::vector<Index> faces;
+
+  friend class Mesh;
+
+public:
+  Index getNoOfVertices() const;
+  Index getNoOfFaces() const;
+
+  /* Silent, so it can run on a background thread; returns false on error */
+  bool saveAsOFF(const char *) const;
+};
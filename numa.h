@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <omp.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+/*
+  Memory and thread placement on NUMA machines, without libnuma.
+
+  Linux puts a page on the node of the thread that first writes it, so
+  storage that the loader thread alone initializes lands on one node and
+  every other node's threads reach it remotely. map() hands out anonymous
+  memory with the transparent huge page hint, and firstTouch() writes it
+  from a team of threads in static chunks, the layout in which the
+  simplifier hands out index blocks, so every block starts out on the node
+  of its thread. bind() pins the OpenMP threads to CPUs, so they stay on
+  those nodes.
+
+  The topology comes from sysfs. Without it, or on a single node, there is
+  one node of all allowed CPUs and placement degrades to the huge page hint.
+*/
+class Numa {
+public:
+  enum Affinity { NONE, COMPACT, SCATTER };
+
+  static const size_t PAGE_SIZE = 4096;
+
+private:
+  /* CPUs of a list such as "0-3,8,10-11" */
+  static std::vector<int> parseCpuList(const char *list) {
+    std::vector<int> cpus;
+    for (const char *p = list; *p;) {
+      int first, last, n;
+      if (sscanf(p, "%d%n", &first, &n) != 1) {
+        break;
+      }
+      p += n;
+      last = first;
+      if (*p == '-' && sscanf(p + 1, "%d%n", &last, &n) == 1) {
+        p += n + 1;
+      }
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+      p += *p == ',';
+    }
+    return cpus;
+  }
+
+  static std::vector<std::vector<int>> readNodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+      for (int cpu = 0; cpu < omp_get_num_procs(); cpu++) {
+        CPU_SET(cpu, &allowed);
+      }
+    }
+
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0;; node++) {
+      std::string path = "/sys/devices/system/node/node" +
+                         std::to_string(node) + "/cpulist";
+      FILE *file = fopen(path.c_str(), "r");
+      if (!file) {
+        break;
+      }
+      char list[4096] = "";
+      if (!fgets(list, sizeof(list), file)) {
+        list[0] = '\0';
+      }
+      fclose(file);
+
+      std::vector<int> cpus;
+      for (int cpu : parseCpuList(list)) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+          cpus.push_back(cpu);
+        }
+      }
+      if (!cpus.empty()) {
+        nodes.push_back(cpus);
+      }
+    }
+
+    if (nodes.empty()) {
+      nodes.push_back(std::vector<int>());
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+          nodes.back().push_back(cpu);
+        }
+      }
+    }
+    return nodes;
+  }
+
+public:
+  /* Allowed CPUs of every node that has any */
+  static const std::vector<std::vector<int>> &getNodes() {
+    static const std::vector<std::vector<int>> nodes = readNodes();
+    return nodes;
+  }
+
+  static int getNoOfNodes() { return getNodes().size(); }
+
+  static bool parse(const char *name, Affinity &affinity) {
+    if (!strcmp(name, "none")) {
+      affinity = NONE;
+    } else if (!strcmp(name, "compact")) {
+      affinity = COMPACT;
+    } else if (!strcmp(name, "scatter")) {
+      affinity = SCATTER;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static const char *getName(Affinity affinity) {
+    static const char *names[] = {"none", "compact", "scatter"};
+    return names[affinity];
+  }
+
+  /*
+    Pin the threads of an OpenMP team of <noOfThreads>: COMPACT fills the
+    CPUs of one node before the next, SCATTER deals threads out to the nodes
+    in turn, NONE lets them run on any allowed CPU again. The runtime keeps
+    its threads between parallel regions, so teams of the same size keep
+    their CPUs; a larger team starts its extra threads with the mask of the
+    master. Returns false if the kernel refused a mask.
+  */
+  static bool bind(Affinity affinity, int noOfThreads) {
+    const std::vector<std::vector<int>> &nodes = getNodes();
+    std::vector<int> cpus;
+    if (affinity == COMPACT) {
+      for (const std::vector<int> &node : nodes) {
+        cpus.insert(cpus.end(), node.begin(), node.end());
+      }
+    } else if (affinity == SCATTER) {
+      for (int i = 0; (int)cpus.size() < noOfThreads; i++) {
+        const std::vector<int> &node = nodes[i % nodes.size()];
+        cpus.push_back(node[i / nodes.size() % node.size()]);
+      }
+    }
+
+    bool bound = true;
+#pragma omp parallel num_threads(noOfThreads) reduction(&& : bound)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (affinity == NONE) {
+        for (const std::vector<int> &node : nodes) {
+          for (int cpu : node) {
+            CPU_SET(cpu, &set);
+          }
+        }
+      } else {
+        CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+      }
+      bound = !sched_setaffinity(0, sizeof(set), &set);
+    }
+    return bound;
+  }
+
+  /*
+    <bytes> of zeroed anonymous memory, advised to be backed by huge pages
+    where the kernel has them enabled; NULL if the mapping failed.
+  */
+  static void *map(size_t bytes) {
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+    return memory;
+  }
+
+  static void unmap(void *memory, size_t bytes) { munmap(memory, bytes); }
+
+  /*
+    Write one byte per page of <memory>, split into one static chunk per
+    thread of the current team size, so every chunk is backed on the node of
+    the thread that later works on the same range.
+  */
+  static void firstTouch(void *memory, size_t bytes) {
+    volatile char *pages = (volatile char *)memory;
+    long long noOfPages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+#pragma omp parallel for schedule(static)
+    for (long long p = 0; p < noOfPages; p++) {
+      pages[p * PAGE_SIZE] = 0;
+    }
+  }
+};
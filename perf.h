@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+  Linux performance counters of the whole process, read at telemetry phase
+  boundaries (telemetry.h) so every phase reports its own counts.
+
+  Counters are per thread: every thread of the process gets its own set,
+  opened from the calling thread through its tid when a read first sees it,
+  and a read sums all of them. enable() starts the OpenMP pool up front so
+  its threads are counted from the first phase on. Events are opened one by
+  one and scaled by enabled/running time when the kernel multiplexes them.
+
+  Events the kernel refuses (no PMU in containers and VMs, or
+  perf_event_paranoid) are left out, so a run without any counter simply
+  reports none.
+*/
+class PerfCounters {
+  struct Event {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  std::mutex mutex;
+  bool enabled;
+  std::vector<Event> events;         // the ones that could be opened
+  std::set<pid_t> threads;           // tids with counters open
+  std::vector<std::vector<int>> fds; // [event][thread]
+
+  PerfCounters() : enabled(false) {}
+  PerfCounters(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+    for (auto &eventFds : this->fds) {
+      for (int fd : eventFds) {
+        close(fd);
+      }
+    }
+  }
+
+  static int open(const Event &event, pid_t tid) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+  }
+
+  /* Open counters for the threads that appeared since the last read */
+  void attachNewThreads() {
+    DIR *tasks = opendir("/proc/self/task");
+    if (!tasks) {
+      return;
+    }
+    while (dirent *entry = readdir(tasks)) {
+      pid_t tid = atoi(entry->d_name);
+      if (tid <= 0 || !this->threads.insert(tid).second) {
+        continue;
+      }
+      for (int e = 0; e < (int)this->events.size(); e++) {
+        int fd = open(this->events[e], tid);
+        if (fd >= 0) {
+          this->fds[e].push_back(fd);
+        }
+      }
+    }
+    closedir(tasks);
+  }
+
+public:
+  static PerfCounters &get() {
+    static PerfCounters counters;
+    return counters;
+  }
+
+  /*
+    Probe the events on the calling thread and keep those available. Call
+    once, before the phases to be measured. Returns the number of events.
+  */
+  int enable(int noOfThreads) {
+    static const Event candidates[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"cache_references", PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_CACHE_REFERENCES},
+        {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    };
+
+    // Start the OpenMP pool, so its threads exist before the first phase
+#pragma omp parallel num_threads(noOfThreads)
+    { (void)noOfThreads; }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (const Event &event : candidates) {
+      int fd = open(event, 0);
+      if (fd >= 0) {
+        close(fd);
+        this->events.push_back(event);
+      }
+    }
+    this->fds.assign(this->events.size(), std::vector<int>());
+    this->attachNewThreads();
+    this->enabled = !this->events.empty();
+    return this->events.size();
+  }
+
+  bool isEnabled() const { return this->enabled; }
+
+  /* Names of the available events, in the order read() returns them */
+  std::vector<std::string> getNames() const {
+    std::vector<std::string> names;
+    for (const Event &event : this->events) {
+      names.push_back(event.name);
+    }
+    return names;
+  }
+
+  /* Current totals over every thread, scaled for multiplexing */
+  std::vector<long long> read() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->attachNewThreads();
+
+    std::vector<long long> totals(this->events.size(), 0);
+    for (int e = 0; e < (int)this->events.size(); e++) {
+      for (int fd : this->fds[e]) {
+        uint64_t value[3]; // value, time enabled, time running
+        if (::read(fd, value, sizeof(value)) != sizeof(value) || !value[2]) {
+          continue;
+        }
+        totals[e] += value[2] < value[1]
+                         ? (long long)((double)value[0] * value[1] / value[2])
+                         : (long long)value[0];
+      }
+    }
+    return totals;
+  }
+};
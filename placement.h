@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include "precision.h"
+
+/*
+  Where the surviving vertex of an edge collapse goes, and what the collapse
+  costs, for a batch of up to BATCH_SIZE edges at a time.
+
+  MIDPOINT places it halfway along the edge. OPTIMAL places it where v'Qv of
+  the summed quadric Q of both end points is least: the solution of the
+  upper 3x3 block of Q times v = -(last column of Q) (Garland, 97), found by
+  Cramer's rule. Where the block is (close to) singular, on flat or
+  cylindrical patches, the cheapest of both end points and the midpoint is
+  taken instead.
+
+  Edges are added one by one and stored transposed, one array per quadric
+  coefficient with one lane per edge, so solve() is a single branch-free
+  loop over the lanes that OpenMP vectorizes; singular lanes are blended
+  with their fallback rather than branched on. That needs -fno-trapping-math
+  (in CFLAGS), or GCC will not evaluate both sides of a blend. Build with
+  make NATIVE=1 for the widest vectors of the build machine.
+
+  Quadrics and costs are solved in <T>, positions taken and returned in <S>.
+  Placement is the batch in the precision of the build (precision.h); the
+  reference engine, which stays in double, uses BasicPlacement<double, double>.
+*/
+template <typename T, typename S> class BasicPlacement {
+public:
+  enum Policy { MIDPOINT, OPTIMAL };
+
+  static const int BATCH_SIZE = 64;
+
+  /*
+    Determinant below which the block counts as singular, relative to the
+    largest determinant a positive semi-definite block of the same trace
+    can have
+  */
+  static constexpr double SINGULAR = 1e-10;
+
+private:
+  // Upper triangle of Q, row by row: q00 q01 q02 q03 q11 q12 q13 q22 q23 q33
+  alignas(64) T q[10][BATCH_SIZE];
+  alignas(64) T p1[3][BATCH_SIZE];
+  alignas(64) T p2[3][BATCH_SIZE];
+  alignas(64) T position[3][BATCH_SIZE];
+  alignas(64) double cost[BATCH_SIZE];
+  int count;
+
+public:
+  BasicPlacement() : count(0) {}
+  BasicPlacement(const BasicPlacement &) = delete;
+
+  static bool parse(const char *name, Policy &policy) {
+    if (!strcmp(name, "midpoint")) {
+      policy = MIDPOINT;
+    } else if (!strcmp(name, "optimal")) {
+      policy = OPTIMAL;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static const char *getName(Policy policy) {
+    static const char *names[] = {"midpoint", "optimal"};
+    return names[policy];
+  }
+
+  int getSize() const { return this->count; }
+  bool isFull() const { return this->count == BATCH_SIZE; }
+  void clear() { this->count = 0; }
+
+  /* Queue the edge from <v1> to <v2> of summed quadric <Q>; returns its lane */
+  int add(const T Q[4][4], const S v1[3], const S v2[3]) {
+    int i = this->count++;
+    int k = 0;
+    for (int r = 0; r < 4; r++) {
+      for (int c = r; c < 4; c++) {
+        this->q[k++][i] = Q[r][c];
+      }
+    }
+    for (int d = 0; d < 3; d++) {
+      this->p1[d][i] = v1[d];
+      this->p2[d][i] = v2[d];
+    }
+    return i;
+  }
+
+  /* Place every queued edge and cost it under <policy> */
+  void solve(Policy policy) {
+    const int n = this->count;
+
+    // v'Qv at (px, py, pz, 1), from the upper triangle
+    auto error = [](T q00, T q01, T q02, T q03, T q11, T q12, T q13, T q22,
+                    T q23, T q33, T px, T py, T pz) {
+      return px * (q00 * px + 2 * (q01 * py + q02 * pz + q03)) +
+             py * (q11 * py + 2 * (q12 * pz + q13)) +
+             pz * (q22 * pz + 2 * q23) + q33;
+    };
+
+    if (policy == MIDPOINT) {
+#pragma omp simd
+      for (int i = 0; i < n; i++) {
+        T mx = (this->p1[0][i] + this->p2[0][i]) / 2;
+        T my = (this->p1[1][i] + this->p2[1][i]) / 2;
+        T mz = (this->p1[2][i] + this->p2[2][i]) / 2;
+        this->position[0][i] = mx;
+        this->position[1][i] = my;
+        this->position[2][i] = mz;
+        this->cost[i] =
+            error(this->q[0][i], this->q[1][i], this->q[2][i], this->q[3][i],
+                  this->q[4][i], this->q[5][i], this->q[6][i], this->q[7][i],
+                  this->q[8][i], this->q[9][i], mx, my, mz);
+      }
+      return;
+    }
+
+#pragma omp simd
+    for (int i = 0; i < n; i++) {
+      T q00 = this->q[0][i], q01 = this->q[1][i], q02 = this->q[2][i];
+      T q03 = this->q[3][i], q11 = this->q[4][i], q12 = this->q[5][i];
+      T q13 = this->q[6][i], q22 = this->q[7][i], q23 = this->q[8][i];
+      T q33 = this->q[9][i];
+
+      // Fallback: the cheapest of v1, v2 and the midpoint; on ties the
+      // midpoint, then v1
+      T ax = this->p1[0][i], ay = this->p1[1][i], az = this->p1[2][i];
+      T bx = this->p2[0][i], by = this->p2[1][i], bz = this->p2[2][i];
+      T mx = (ax + bx) / 2, my = (ay + by) / 2, mz = (az + bz) / 2;
+      T ea = error(q00, q01, q02, q03, q11, q12, q13, q22, q23, q33, ax, ay,
+                   az);
+      T eb = error(q00, q01, q02, q03, q11, q12, q13, q22, q23, q33, bx, by,
+                   bz);
+      T em = error(q00, q01, q02, q03, q11, q12, q13, q22, q23, q33, mx, my,
+                   mz);
+      bool b = eb < ea;
+      T cx = b ? bx : ax, cy = b ? by : ay, cz = b ? bz : az;
+      T ce = b ? eb : ea;
+      bool c = ce < em;
+      T fx = c ? cx : mx, fy = c ? cy : my, fz = c ? cz : mz;
+      T fe = c ? ce : em;
+
+      // Cramer's rule on the symmetric block, through its adjugate
+      T c00 = q11 * q22 - q12 * q12;
+      T c01 = q02 * q12 - q01 * q22;
+      T c02 = q01 * q12 - q02 * q11;
+      T c11 = q00 * q22 - q02 * q02;
+      T c12 = q01 * q02 - q00 * q12;
+      T c22 = q00 * q11 - q01 * q01;
+      T det = q00 * c00 + q01 * c01 + q02 * c02;
+      T trace = (q00 + q11 + q22) / 3;
+      bool solved = std::fabs(det) > (T)SINGULAR * trace * trace * trace;
+      T inverse = 1 / det; // inf or NaN on singular lanes, blended out
+      T ox = -(c00 * q03 + c01 * q13 + c02 * q23) * inverse;
+      T oy = -(c01 * q03 + c11 * q13 + c12 * q23) * inverse;
+      T oz = -(c02 * q03 + c12 * q13 + c22 * q23) * inverse;
+      T oe = error(q00, q01, q02, q03, q11, q12, q13, q22, q23, q33, ox, oy,
+                   oz);
+
+      this->position[0][i] = solved ? ox : fx;
+      this->position[1][i] = solved ? oy : fy;
+      this->position[2][i] = solved ? oz : fz;
+      this->cost[i] = solved ? oe : fe;
+    }
+  }
+
+  S getX(int lane) const { return this->position[0][lane]; }
+  S getY(int lane) const { return this->position[1][lane]; }
+  S getZ(int lane) const { return this->position[2][lane]; }
+  double getCost(int lane) const { return this->cost[lane]; }
+};
+
+typedef BasicPlacement<QuadricScalar, Scalar> Placement;
@@ -0,0 +1,263 @@
+#include "pm.h"
+
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char PM_MAGIC[4] = {'P', 'M', 'L', 'G'};
+static const int PM_VERSION = 1;
+
+/******************************************************************************/
+/* ProgressiveMesh */
+
+ProgressiveMesh::ProgressiveMesh(const Mesh *mesh) {
+  this->vertices.reserve(3 * mesh->getNoOfVertices());
+  for (const Vertex *v : mesh->getVertices()) {
+    this->vertices.push_back(v->getX());
+    this->vertices.push_back(v->getY());
+    this->vertices.push_back(v->getZ());
+  }
+
+  this->faces.reserve(3 * mesh->getNoOfFaces());
+  for (const Face *f : mesh->getFaces()) {
+    for (int i = 0; i < 3; i++) {
+      this->faces.push_back(f->getVertex(i)->getId());
+    }
+  }
+
+  // Every collapse removes one vertex, and every face is removed at most once
+  this->records.resize(mesh->getNoOfVertices() + mesh->getNoOfFaces() / 2 + 1);
+  this->noOfRecords = 0;
+  this->noOfCollapses = 0;
+}
+
+void ProgressiveMesh::record(const Vertex *v1, const Vertex *v2,
+                             const std::vector<Face *> &removedFaces) {
+  int noOfFaces = removedFaces.size();
+  int noOfSlots = noOfFaces > 2 ? 1 + (noOfFaces - 1) / 2 : 1;
+  int index = this->noOfRecords.fetch_add(noOfSlots);
+  this->noOfCollapses++;
+
+  for (int i = 0; i < noOfSlots; i++) {
+    Record &r = this->records[index + i];
+    r.v1 = i ? -1 : v1->getId();
+    r.v2 = v2->getId();
+    r.f1 = 2 * i < noOfFaces ? removedFaces[2 * i]->getId() : -1;
+    r.f2 = 2 * i + 1 < noOfFaces ? removedFaces[2 * i + 1]->getId() : -1;
+    r.x = v2->getX();
+    r.y = v2->getY();
+    r.z = v2->getZ();
+  }
+}
+
+void ProgressiveMesh::save(const char *logFile) const {
+  std::cout << std::endl;
+  std::cout << "Saving progressive mesh log... ";
+
+  FILE *file = fopen(logFile, "wb");
+  if (!file) {
+    std::cerr << std::endl
+              << "Error:  Unable to "
+                 "create progressive mesh log."
+              << std::endl;
+    exit(16);
+  }
+
+  Header header;
+  memcpy(header.magic, PM_MAGIC, sizeof(PM_MAGIC));
+  header.version = PM_VERSION;
+  header.noOfVertices = this->vertices.size() / 3;
+  header.noOfFaces = this->faces.size() / 3;
+  header.noOfCollapses = this->noOfCollapses;
+  header.noOfRecords = this->noOfRecords;
+
+  fwrite(&header, sizeof(Header), 1, file);
+  fwrite(this->vertices.data(), sizeof(double), this->vertices.size(), file);
+  fwrite(this->faces.data(), sizeof(int32_t), this->faces.size(), file);
+  fwrite(this->records.data(), sizeof(Record), header.noOfRecords, file);
+  fclose(file);
+
+  std::cout << "Done [" << header.noOfCollapses << " collapse(s)]"
+            << std::endl;
+}
+
+/******************************************************************************/
+/* ProgressiveMeshExtractor */
+
+ProgressiveMeshExtractor::ProgressiveMeshExtractor(const char *logFile) {
+  struct stat st;
+
+  this->fd = open(logFile, O_RDONLY);
+  if (this->fd < 0 || fstat(this->fd, &st)) {
+    std::cerr << std::endl
+              << "Error:  Unable to read "
+                 "progressive mesh log. Please check "
+                 "the file "
+                 "path and permissions."
+              << std::endl;
+    exit(21);
+  }
+  this->size = st.st_size;
+
+  void *data = NULL;
+  if (this->size >= sizeof(ProgressiveMesh::Header)) {
+    data = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+  }
+  this->data = data == MAP_FAILED ? NULL : (const char *)data;
+  this->header = (const ProgressiveMesh::Header *)this->data;
+
+  if (!this->data || memcmp(this->header->magic, PM_MAGIC, 4) ||
+      this->header->version != PM_VERSION ||
+      this->size != sizeof(ProgressiveMesh::Header) +
+                        sizeof(double) * 3 * this->header->noOfVertices +
+                        sizeof(int32_t) * 3 * this->header->noOfFaces +
+                        sizeof(ProgressiveMesh::Record) *
+                            this->header->noOfRecords) {
+    std::cerr << std::endl
+              << "Error:  Invalid progressive mesh log." << std::endl;
+    exit(22);
+  }
+
+  this->vertices =
+      (const double *)(this->data + sizeof(ProgressiveMesh::Header));
+  this->faces = (const int32_t *)(this->vertices + 3 * getNoOfVertices());
+  this->records =
+      (const ProgressiveMesh::Record *)(this->faces + 3 * getNoOfFaces());
+}
+
+ProgressiveMeshExtractor::~ProgressiveMeshExtractor() {
+  munmap((void *)this->data, this->size);
+  close(this->fd);
+}
+
+int ProgressiveMeshExtractor::getNoOfVertices() const {
+  return this->header->noOfVertices;
+}
+
+int ProgressiveMeshExtractor::getNoOfFaces() const {
+  return this->header->noOfFaces;
+}
+
+int ProgressiveMeshExtractor::getNoOfCollapses() const {
+  return this->header->noOfCollapses;
+}
+
+int ProgressiveMeshExtractor::getNoOfRecords() const {
+  return this->header->noOfRecords;
+}
+
+size_t ProgressiveMeshExtractor::getSize() const { return this->size; }
+
+const double *ProgressiveMeshExtractor::getVertices() const {
+  return this->vertices;
+}
+
+const int32_t *ProgressiveMeshExtractor::getFaces() const {
+  return this->faces;
+}
+
+const ProgressiveMesh::Record *ProgressiveMeshExtractor::getRecords() const {
+  return this->records;
+}
+
+void ProgressiveMeshExtractor::extractVertices(int target,
+                                               const char *outputFile) const {
+  this->extract(getNoOfVertices() - target, -1, outputFile);
+}
+
+void ProgressiveMeshExtractor::extractFaces(int target,
+                                            const char *outputFile) const {
+  this->extract(INT_MAX, target, outputFile);
+}
+
+/*
+  Replay collapses until <noOfCollapses> have been applied or at most
+  <targetFaces> faces remain. Merged vertices are tracked with a union-find
+  forest, so faces are only rewritten once, when the mesh is emitted. Output
+  ordering matches Mesh::write.
+*/
+void ProgressiveMeshExtractor::extract(int noOfCollapses, int targetFaces,
+                                       const char *outputFile) const {
+  int noOfVertices = getNoOfVertices();
+  int noOfFaces = getNoOfFaces();
+
+  std::vector<double> position(this->vertices,
+                               this->vertices + 3 * noOfVertices);
+  std::vector<int> parent(noOfVertices);
+  for (int i = 0; i < noOfVertices; i++) {
+    parent[i] = i;
+  }
+  std::vector<char> faceRemoved(noOfFaces, 0);
+
+  int collapses = 0;
+  int liveFaces = noOfFaces;
+  for (int i = 0; i < this->header->noOfRecords; i++) {
+    const ProgressiveMesh::Record &r = this->records[i];
+    if (r.v1 >= 0) {
+      if (collapses >= noOfCollapses || liveFaces <= targetFaces) {
+        break;
+      }
+      parent[r.v1] = r.v2;
+      collapses++;
+    }
+    position[3 * r.v2] = r.x;
+    position[3 * r.v2 + 1] = r.y;
+    position[3 * r.v2 + 2] = r.z;
+    if (r.f1 >= 0) {
+      faceRemoved[r.f1] = 1;
+      liveFaces--;
+    }
+    if (r.f2 >= 0) {
+      faceRemoved[r.f2] = 1;
+      liveFaces--;
+    }
+  }
+
+  FILE *file = fopen(outputFile, "w");
+  if (!file) {
+    std::cerr << std::endl
+              << "Error:  Unable to "
+                 "create output file."
+              << std::endl;
+    exit(16);
+  }
+
+  // Surviving vertices keep their input order
+  std::vector<int> id(noOfVertices, -1);
+  int liveVertices = 0;
+  for (int i = 0; i < noOfVertices; i++) {
+    if (parent[i] == i) {
+      id[i] = liveVertices++;
+    }
+  }
+
+  fprintf(file, "OFF\n");
+  fprintf(file, "%d %d %d\n", liveVertices, liveFaces, 0);
+
+  for (int i = 0; i < noOfVertices; i++) {
+    if (id[i] >= 0) {
+      fprintf(file, "%lf %lf %lf\n", position[3 * i], position[3 * i + 1],
+              position[3 * i + 2]);
+    }
+  }
+
+  int v[3];
+  for (int f = 0; f < noOfFaces; f++) {
+    if (faceRemoved[f]) {
+      continue;
+    }
+    for (int i = 0; i < 3; i++) {
+      int root = this->faces[3 * f + i];
+      while (parent[root] != root) {
+        parent[root] = parent[parent[root]];
+        root = parent[root];
+      }
+      v[i] = id[root];
+    }
+    fprintf(file, "%d %d %d %d\n", 3, v[0], v[1], v[2]);
+  }
+
+  fclose(file);
+}
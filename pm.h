@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+/*
+  Progressive-mesh log: the input mesh followed by every edge collapse of one
+  simplification run, in the order the collapses were applied. Replaying a
+  prefix of the log reproduces the mesh the run had at that point, so any
+  level of detail down to the depth of the run can be extracted without
+  simplifying again.
+
+  File layout (native byte order):
+    Header
+    double  vertices[noOfVertices][3]
+    int32_t faces[noOfFaces][3]
+    Record  records[noOfRecords]
+*/
+class ProgressiveMesh {
+public:
+  struct Header {
+    char magic[4];
+    int32_t version;
+    int32_t noOfVertices;
+    int32_t noOfFaces;
+    int32_t noOfCollapses;
+    int32_t noOfRecords;
+  };
+
+  /*
+    Vertex v1 is merged into v2, which moves to (x, y, z), and faces f1 and f2
+    are removed (-1 when unused). A collapse that removes more than two faces
+    is followed by records with v1 = -1 carrying the remaining faces.
+  */
+  struct Record {
+    int32_t v1, v2;
+    int32_t f1, f2;
+    double x, y, z;
+  };
+
+private:
+  std::vector<double> vertices;
+  std::vector<int32_t> faces;
+  std::vector<Record> records;
+  std::atomic<int> noOfRecords;
+  std::atomic<int> noOfCollapses;
+
+public:
+  ProgressiveMesh() = delete;
+  ProgressiveMesh(const Mesh *);
+
+  /* Thread-safe; called once the collapse has been applied to the mesh */
+  void record(const Vertex *v1, const Vertex *v2,
+              const std::vector<Face *> &removedFaces);
+  void save(const char *) const;
+};
+
+/******************************************************************************/
+
+class ProgressiveMeshExtractor {
+  int fd;
+  size_t size;
+  const char *data;
+
+  const ProgressiveMesh::Header *header;
+  const double *vertices;
+  const int32_t *faces;
+  const ProgressiveMesh::Record *records;
+
+public:
+  ProgressiveMeshExtractor() = delete;
+  ProgressiveMeshExtractor(const char *logFile);
+  ~ProgressiveMeshExtractor();
+
+  int getNoOfVertices() const;
+  int getNoOfFaces() const;
+  int getNoOfCollapses() const;
+  int getNoOfRecords() const;
+  size_t getSize() const;
+
+  /* The log itself, for tools replaying it their own way */
+  const double *getVertices() const;
+  const int32_t *getFaces() const;
+  const ProgressiveMesh::Record *getRecords() const;
+
+  /* Write the mesh with at most <target> vertices (or faces) as OFF */
+  void extractVertices(int target, const char *outputFile) const;
+  void extractFaces(int target, const char *outputFile) const;
+
+private:
+  void extract(int noOfCollapses, int targetFaces,
+               const char *outputFile) const;
+};
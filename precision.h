@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+  Floating-point types of the mesh and quadric kernels of both top-level
+  engines, chosen at build time with make PRECISION=<name>:
+
+    double  positions and quadrics in double (default)
+    mixed   positions stored in float, quadrics accumulated and costs
+            evaluated in double, which is where cancellation hurts
+    single  both in float, for preview runs; v'Qv cancels badly on flat
+            regions, where costs and errors can come out below zero
+
+  Plane normals are still found in double from the stored positions, and
+  volumes and errors are reported in double. Run make clean first, objects
+  are not rebuilt when it changes.
+*/
+#if defined(PRECISION_SINGLE)
+typedef float Scalar;
+typedef float QuadricScalar;
+#define PRECISION_NAME "single"
+#elif defined(PRECISION_MIXED)
+typedef float Scalar;
+typedef double QuadricScalar;
+#define PRECISION_NAME "mixed"
+#else
+typedef double Scalar;
+typedef double QuadricScalar;
+#define PRECISION_NAME "double"
+#endif
+
+typedef QuadricScalar Quadric[4][4];
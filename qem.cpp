@@ -1,17 +1,27 @@
 #include "qem.h"
 #include "mesh.h"
 
-QuadricErrorMetrics::QuadricErrorMetrics() {}
+#include <cmath>
+#include <parallel/algorithm>
+
+QuadricErrorMetrics::QuadricErrorMetrics() {
+  this->progressiveMesh = NULL;
+  this->heatmap = NULL;
+  this->maxError = DBL_MAX;
+  this->deadline = NULL;
+  this->partitioning = INDEX;
+  this->placementPolicy = Placement::OPTIMAL;
+}
 
-double QuadricErrorMetrics::calculateError(const Vertex *vertex) const {
-  double cost = 0.0;
-  double vQ[4] = {0};
-  double v[4] = {vertex->getX(), vertex->getY(), vertex->getZ(), 1};
+double QuadricErrorMetrics::calculateError(const QuadricScalar v[4],
+                                           const Quadric Q) {
+  QuadricScalar cost = 0.0;
+  QuadricScalar vQ[4] = {0};
 
   // v'(row vector) dot Q (4x4 matrix)
   for (int i = 0; i < 4; ++i) {
     for (int j = 0; j < 4; ++j) {
-      vQ[i] += v[j] * vertex->Q[j][i];
+      vQ[i] += v[j] * Q[j][i];
     }
   }
 
@@ -22,9 +32,13 @@ double QuadricErrorMetrics::calculateError(const Vertex *vertex) const {
   return cost;
 }
 
+double QuadricErrorMetrics::calculateError(const Vertex *vertex) const {
+  QuadricScalar v[4] = {vertex->getX(), vertex->getY(), vertex->getZ(), 1};
+  return calculateError(v, vertex->Q);
+}
+
 /* Add quadric matrix b to quadric matrix a */
-void QuadricErrorMetrics::sumQuadrics(double a[4][4],
-                                      const double b[4][4]) const {
+void QuadricErrorMetrics::sumQuadrics(Quadric a, const Quadric b) {
   for (int i = 0; i < 4; ++i) {
     for (int j = 0; j < 4; ++j) {
       a[i][j] += b[i][j];
@@ -32,13 +46,58 @@ void QuadricErrorMetrics::sumQuadrics(double a[4][4],
   }
 }
 
-double QuadricErrorMetrics::calculateEdgeCost(const Edge *edge) const {
-  Vertex *placement = (Vertex *)edge->getPlacement();
-  // Cost is given by v'Qv, where v is placement vertex
-  memcpy(placement->Q, edge->getV1()->Q, sizeof(double) * 16);
-  this->sumQuadrics(placement->Q, edge->getV2()->Q);
+/* Fundamental quadric Kp of the plane through p0, p1 and p2 */
+void QuadricErrorMetrics::calculatePlaneQuadric(const double p0[3],
+                                                const double p1[3],
+                                                const double p2[3],
+                                                Quadric Kp) {
+  Vec3 v0{p0[0], p0[1], p0[2]};
+  Vec3 v1{p1[0], p1[1], p1[2]};
+  Vec3 v2{p2[0], p2[1], p2[2]};
+
+  // Normalize so that x² + y² + z² = 1, and apply v0 to find parameter d
+  Vec4 p = plane(normalize(cross(v1 - v0, v2 - v0)), v0);
+  double coefficients[4] = {p.x, p.y, p.z, p.w};
+
+  // For this plane, the fundamental quadric Kp is the product of vectors
+  // coefficients and coefficients'
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      Kp[i][j] = coefficients[i] * coefficients[j];
+    }
+  }
+}
 
-  return this->calculateError(placement);
+/*
+  Place and cost <n> edges, a batch at a time, on the sum of their end point
+  quadrics.
+*/
+void QuadricErrorMetrics::calculateEdgeCosts(Edge *const *edges,
+                                             Index n) const {
+  Placement batch;
+  Quadric Q;
+  for (Index first = 0; first < n; first += Placement::BATCH_SIZE) {
+    Index last = std::min(n, first + Placement::BATCH_SIZE);
+    batch.clear();
+    for (Index i = first; i < last; i++) {
+      const Vertex *v1 = edges[i]->getV1();
+      const Vertex *v2 = edges[i]->getV2();
+      memcpy(Q, v1->Q, sizeof(Quadric));
+      this->sumQuadrics(Q, v2->Q);
+
+      Scalar p1[3] = {v1->getX(), v1->getY(), v1->getZ()};
+      Scalar p2[3] = {v2->getX(), v2->getY(), v2->getZ()};
+      batch.add(Q, p1, p2);
+    }
+
+    batch.solve(this->placementPolicy);
+    for (Index i = first; i < last; i++) {
+      int lane = i - first;
+      edges[i]->setPlacement(batch.getX(lane), batch.getY(lane),
+                             batch.getZ(lane));
+      edges[i]->setCost(batch.getCost(lane));
+    }
+  }
 }
 
 bool QuadricErrorMetrics::collapseEdge(Edge *edgeToBeCollapsed) {
@@ -50,265 +109,712 @@ bool QuadricErrorMetrics::collapseEdge(Edge *edgeToBeCollapsed) {
 
   Vertex *v1 = (Vertex *)edgeToBeCollapsed->getV1();
   Vertex *v2 = (Vertex *)edgeToBeCollapsed->getV2();
-  assert(v1 && v2);
 
-  // TODO: Check if the cost of edge has changed
-  if (!v1->hasFaces() || !v2->hasFaces()) {
+  std::vector<Face *> facesToBeRmoved;
+  if (!Mesh::collapseEdge(edgeToBeCollapsed, edgeToBeCollapsed->getPlacement(),
+                          facesToBeRmoved)) {
     return collapsed;
   }
+  collapsed = true;
 
-  // ---------------------------------------------------------------------------
-  /* Remove faces associated with the collapsed edge */
-  auto ef = edgeToBeCollapsed->getFaces();
-  std::vector<Face *> facesToBeRmoved(ef.begin(), ef.end());
-  for (Face *f : facesToBeRmoved) {
-    f->remove();
+  // v2 inherits the quadrics of both end points, as its placement assumed
+  this->sumQuadrics(v2->Q, v1->Q);
+
+  if (this->progressiveMesh) {
+    this->progressiveMesh->record(v1, v2, facesToBeRmoved);
   }
 
   // ---------------------------------------------------------------------------
-  /* Remove the collapsed edge */
-  edgeToBeCollapsed->remove();
+  // Finally, update the cost of all edges of v2 vertex
+  TELEMETRY_COUNT("edge_cost_updates", v2->getOutgoingEdges().size() +
+                                           v2->getIncomingEdges().size());
+  const EdgeList &outgoingEdges = v2->getOutgoingEdges();
+  const EdgeList &incomingEdges = v2->getIncomingEdges();
+  for (Edge *e : outgoingEdges) { // from
+    e->modifiy();
+  }
+  for (Edge *e : incomingEdges) { // to
+    e->modifiy();
+  }
+  this->calculateEdgeCosts(outgoingEdges.begin(), outgoingEdges.size());
+  this->calculateEdgeCosts(incomingEdges.begin(), incomingEdges.size());
 
-  // ---------------------------------------------------------------------------
-  /* Set the v2 vertex to the value of edge->placement */
-  v2->update(edgeToBeCollapsed->getPlacement());
+  return collapsed;
+}
 
-  // ---------------------------------------------------------------------------
-  /* Update all edges of the v1 vertex */
-  std::map<Vertex *, Edge *> v2NeighbourMap;
-  for (Edge *ie : v2->getIncomingEdges()) {
-    assert(ie && ie != edgeToBeCollapsed);
-    v2NeighbourMap[(Vertex *)ie->getV1()] = ie;
+bool QuadricErrorMetrics::isCrownInCell(const Vertex *vertex,
+                                        const std::vector<int> &cells) const {
+  int cell = cells[vertex->getId()];
+  for (Edge *oe : vertex->getOutgoingEdges()) {
+    if (cells[oe->getV2()->getId()] != cell) {
+      return false;
+    }
   }
-  for (Edge *oe : v2->getOutgoingEdges()) {
-    assert(oe && oe != edgeToBeCollapsed);
-    v2NeighbourMap[(Vertex *)oe->getV2()] = oe;
+  for (Edge *ie : vertex->getIncomingEdges()) {
+    if (cells[ie->getV1()->getId()] != cell) {
+      return false;
+    }
   }
+  return true;
+}
+
+void QuadricErrorMetrics::calculateQuadrics(Mesh *mesh) const {
+  std::cout << "Calculating quadrics... ";
 
-  // Update the edge->v2 vertex to v2 for all incoming edges of v1, and add the
-  // edge to v2
-  Edge *de = NULL;
-  for (Edge *ie : v1->getIncomingEdges()) {
-    assert(ie && ie != edgeToBeCollapsed);
+  Quadric Kp;
+  double p[3][3];
 
-    if (v2NeighbourMap.count((Vertex *)ie->getV1())) {
-      de = ie;
-    } else {
-      ie->setV2(v2);
-      v2->addIncomingEdge(ie);
+  for (Vertex *vertex : mesh->getVertices()) {
+    // From scratch, so a rerun (as in bench/) does not add to stale quadrics
+    memset(vertex->Q, 0, sizeof(Quadric));
+    for (Face *face : vertex->getFaces()) {
+      for (int i = 0; i < 3; ++i) {
+        p[i][0] = face->getVertex(i)->getX();
+        p[i][1] = face->getVertex(i)->getY();
+        p[i][2] = face->getVertex(i)->getZ();
+      }
+      calculatePlaneQuadric(p[0], p[1], p[2], Kp);
+
+      sumQuadrics(vertex->Q, Kp);
     }
   }
-  if (de) {
-    de->remove();
+
+  std::cout << "Done" << std::endl;
+}
+
+void QuadricErrorMetrics::calculateEdgeCosts(Mesh *mesh) const {
+  std::cout << "Calculating edge costs... ";
+
+  const std::vector<Edge *> &edges = mesh->getEdges();
+  this->calculateEdgeCosts(edges.data(), edges.size());
+
+  std::cout << "Done" << std::endl;
+}
+
+double QuadricErrorMetrics::calculateMeshError(const Mesh *mesh) const {
+  double error = 0.0;
+  for (Vertex *vertex : mesh->getVertices()) {
+    if (!vertex->isRemoved()) {
+      error += this->calculateError(vertex);
+    }
   }
+  return error;
+}
+
+/*
+  Grid vertex clustering. The vertices with faces are bucketed into cubic
+  cells over the mesh volume, and those of every cell merged into a single
+  vertex that inherits their summed quadric and is placed on it as a collapse
+  would be (placement.h), from the centroid of the cell. Faces are remapped
+  by Mesh::cluster().
+
+  The grid is the coarsest found whose occupied cells remove at most <target>
+  vertices, so that QEM finishes to its own target exactly. The search starts
+  at <gridResolution> cells along the longest side of the volume and guesses
+  each next resolution as for a surface, whose occupied cells grow with the
+  square of the resolution, within the bracket found so far. Under an error
+  bound, cells whose merged vertex would cost more are left as they are.
+  Returns the number of vertices removed.
+*/
+Index QuadricErrorMetrics::clusterVertices(Mesh *mesh, Index target,
+                                           int gridResolution,
+                                           int noOfThreads) {
+  const std::vector<Vertex *> &vertices = mesh->getVertices();
+  const Volume &volume = mesh->getVolume();
+  Index noOfVertices = vertices.size();
+  Index noOfActiveVertices = mesh->getNoOfActiveVertices();
+  std::cout << "Clustering vertices [target = " << noOfActiveVertices - target
+            << " vertex(s)]... ";
+
+  omp_set_num_threads(noOfThreads);
 
-  // Update the edge->v1 vertex to v2 for all outgoing edges of v1, and add
-  // the edge to v2
-  de = NULL;
-  for (Edge *oe : v1->getOutgoingEdges()) {
-    assert(oe && oe != edgeToBeCollapsed);
+  // Vertices without faces are carried over as they are
+  std::vector<Index> members;
+  for (Index i = 0; i < noOfVertices; i++) {
+    if (!vertices[i]->isRemoved() && vertices[i]->hasFaces()) {
+      members.push_back(i);
+    }
+  }
+  Index noOfMembers = members.size();
+
+  /*
+    Sort the members by cell at <resolution> cells to a side into <keys>, and
+    return the number of occupied cells. A key packs the three cell
+    coordinates into 21 bits each.
+  */
+  const int MAX_RESOLUTION = 1 << 20;
+  double side =
+      std::max({volume.getXDim(), volume.getYDim(), volume.getZDim()});
+  std::vector<std::pair<uint64_t, Index>> keys(noOfMembers);
+  auto bucket = [&](int resolution) {
+    TRACE_SCOPE("bucket", resolution);
+    double size = side / resolution;
+    auto cell = [&](double offset) -> uint64_t {
+      return size > 0 ? std::min(offset / size, resolution - 1.0) : 0;
+    };
+#pragma omp parallel for
+    for (Index i = 0; i < noOfMembers; i++) {
+      const Vertex *v = vertices[members[i]];
+      keys[i] = {cell(v->getX() - volume.getMinX()) << 42 |
+                     cell(v->getY() - volume.getMinY()) << 21 |
+                     cell(v->getZ() - volume.getMinZ()),
+                 members[i]};
+    }
+    __gnu_parallel::sort(keys.begin(), keys.end());
 
-    if (v2NeighbourMap.count((Vertex *)oe->getV2())) {
-      de = oe;
+    Index noOfCells = 0;
+    for (Index i = 0; i < noOfMembers; i++) {
+      noOfCells += i == 0 || keys[i].first != keys[i - 1].first;
+    }
+    return noOfCells;
+  };
+
+  // Within 2% of the fewest cells that leave <goal> vertices is close
+  // enough; QEM makes up the difference
+  Index goal = std::max(noOfMembers - target, (Index)1);
+  int coarse = 0;              // finest resolution found to remove too many
+  int fine = MAX_RESOLUTION;   // coarsest found not to
+  int resolution = std::min(std::max(gridResolution, 1), MAX_RESOLUTION);
+  int bucketed = 0;
+  for (int probe = 0; probe < 16 && !this->isExpired(); probe++) {
+    Index noOfCells = bucket(resolution);
+    bucketed = resolution;
+    if (noOfCells >= goal) {
+      fine = resolution;
+      if (noOfCells <= 1.02 * goal) {
+        break;
+      }
     } else {
-      oe->setV1(v2);
-      v2->addOutgoingEdge(oe);
+      coarse = resolution;
+    }
+    if (fine - coarse <= 1) {
+      break;
     }
+    int guess = resolution *
+                std::sqrt((double)goal / std::max(noOfCells, (Index)1));
+    resolution = std::min(std::max(guess, coarse + 1), fine - 1);
   }
-  if (de) {
-    de->remove();
+  if (bucketed != fine) {
+    bucket(fine);
   }
 
-  // ---------------------------------------------------------------------------
-  /* Update all faces of the v1 vertex */
-
-  for (Face *f : v1->getFaces()) {
-    if (f->getEdges().size() == 2) {
-      for (Vertex *v : f->getVertices()) {
-        if (v2NeighbourMap.count(v)) {
-          f->addEdge(v2NeighbourMap[v]);
-        }
+  std::vector<Index> first; // index in <keys> of the first member of a cell
+  for (Index i = 0; i < noOfMembers; i++) {
+    if (i == 0 || keys[i].first != keys[i - 1].first) {
+      first.push_back(i);
+    }
+  }
+  Index noOfCells = first.size();
+  first.push_back(noOfMembers);
+
+  // Summed quadric, placement and cost of every cell, a batch at a time
+  std::vector<QuadricScalar> cellQuadrics(16 * noOfCells);
+  std::vector<Scalar> cellPositions(3 * noOfCells);
+  std::vector<double> cellCosts(noOfCells);
+  Index noOfBatches =
+      (noOfCells + Placement::BATCH_SIZE - 1) / Placement::BATCH_SIZE;
+#pragma omp parallel for schedule(dynamic)
+  for (Index b = 0; b < noOfBatches; b++) {
+    Placement batch;
+    Index begin = b * Placement::BATCH_SIZE;
+    Index end = std::min(noOfCells, begin + Placement::BATCH_SIZE);
+    for (Index c = begin; c < end; c++) {
+      Quadric Q;
+      memset(Q, 0, sizeof(Quadric));
+      double centroid[3] = {0, 0, 0};
+      for (Index i = first[c]; i < first[c + 1]; i++) {
+        const Vertex *v = vertices[keys[i].second];
+        this->sumQuadrics(Q, v->Q);
+        centroid[0] += v->getX();
+        centroid[1] += v->getY();
+        centroid[2] += v->getZ();
       }
+      Index n = first[c + 1] - first[c];
+      Scalar p[3] = {(Scalar)(centroid[0] / n), (Scalar)(centroid[1] / n),
+                     (Scalar)(centroid[2] / n)};
+      batch.add(Q, p, p);
+      memcpy(&cellQuadrics[16 * c], Q, sizeof(Quadric));
+    }
+
+    batch.solve(this->placementPolicy);
+    for (Index c = begin; c < end; c++) {
+      int lane = c - begin;
+      cellPositions[3 * c] = batch.getX(lane);
+      cellPositions[3 * c + 1] = batch.getY(lane);
+      cellPositions[3 * c + 2] = batch.getZ(lane);
+      cellCosts[c] = batch.getCost(lane);
     }
-    f->replaceVertex(v1, v2);
-    v2->addFace(f);
   }
 
-  // ---------------------------------------------------------------------------
-  /* Remove v1 vertex */
-  v1->remove();
-  collapsed = true;
+  // Cells to merge, by the vertices in them
+  std::vector<Index> cells(noOfVertices, -1);
+  for (Index c = 0; c < noOfCells; c++) {
+    if (first[c + 1] - first[c] > 1 && cellCosts[c] <= this->maxError) {
+      for (Index i = first[c]; i < first[c + 1]; i++) {
+        cells[keys[i].second] = c;
+      }
+    }
+  }
 
-  // ---------------------------------------------------------------------------
-  // Finally, update the cost of all edges of v2 vertex
-  double cost = 0.0;
-  for (Edge *e : v2->getOutgoingEdges()) { // from
-    e->modifiy();
-    double cost = this->calculateEdgeCost(e);
-    e->setCost(cost);
+  /*
+    Number the new vertices in the order of their first member, with the
+    quadrics they are to have once the mesh is rebuilt: the vertices keep the
+    order of the input rather than that of the cells, whose runs of ids would
+    be thin slabs of the volume to the blocks of the QEM stage.
+  */
+  std::vector<Index> clusters(noOfVertices, -1), cellClusters(noOfCells, -1);
+  std::vector<Scalar> positions;
+  std::vector<QuadricScalar> quadrics;
+  double maxError = 0.0;
+  for (Index i = 0; i < noOfVertices; i++) {
+    const Vertex *v = vertices[i];
+    Index c = cells[i];
+    if (c < 0) {
+      if (!v->isRemoved()) {
+        clusters[i] = positions.size() / 3;
+        positions.insert(positions.end(), {v->getX(), v->getY(), v->getZ()});
+        quadrics.insert(quadrics.end(), &v->Q[0][0], &v->Q[0][0] + 16);
+      }
+      continue;
+    }
+    if (cellClusters[c] < 0) {
+      cellClusters[c] = positions.size() / 3;
+      positions.insert(positions.end(), &cellPositions[3 * c],
+                       &cellPositions[3 * c] + 3);
+      quadrics.insert(quadrics.end(), &cellQuadrics[16 * c],
+                      &cellQuadrics[16 * c] + 16);
+      maxError = std::max(maxError, cellCosts[c]);
+    }
+    clusters[i] = cellClusters[c];
   }
 
-  for (Edge *e : v2->getIncomingEdges()) { // from
-    e->modifiy();
-    double cost = this->calculateEdgeCost(e);
-    e->setCost(cost);
+  std::cout << "Done [" << fine << "^3 grid]" << std::endl;
+
+  mesh->cluster(clusters, positions);
+  const std::vector<Vertex *> &merged = mesh->getVertices();
+  for (Index c = 0; c < (Index)merged.size(); c++) {
+    memcpy(merged[c]->Q, &quadrics[16 * c], sizeof(Quadric));
   }
 
-  return collapsed;
+  // An error-bounded shortfall is left for the QEM stage to make up
+  Index removed = noOfActiveVertices - mesh->getNoOfActiveVertices();
+  TELEMETRY_COUNT("cluster_merges", removed);
+  this->report.maxError = std::max(this->report.maxError, maxError);
+  this->report.noOfRemovedVertices += removed;
+  this->report.stoppedAtDeadline = removed < target && this->isExpired();
+
+  return removed;
 }
 
-void QuadricErrorMetrics::calculateQuadrics(Mesh *mesh) const {
-  std::cout << "Calculating quadrics... ";
+/*
+  Split the vertices that still have faces into <noOfRegions> runs of equal
+  length along the Hilbert curve through the mesh volume. <owners> maps
+  every vertex id to its region, -1 for vertices without faces.
+*/
+void QuadricErrorMetrics::partitionVertices(
+    const Mesh *mesh, int noOfRegions,
+    std::vector<std::vector<Vertex *>> &regions,
+    std::vector<int> &owners) const {
+  const std::vector<Vertex *> &vertices = mesh->getVertices();
+  std::vector<Vertex *> live;
+  for (Index i : mesh->getCurveOrder(SpaceFillingCurve::HILBERT)) {
+    if (!vertices[i]->isRemoved() && vertices[i]->hasFaces()) {
+      live.push_back(vertices[i]);
+    }
+  }
 
-  double Kp[4][4];
-  double x, y, z, d;
-  Vector v0v1(0, 0, 0), v0v2(0, 0, 0);
+  regions.assign(noOfRegions, std::vector<Vertex *>());
+  owners.assign(vertices.size(), -1);
+  for (Index i = 0; i < (Index)live.size(); i++) {
+    int region = (long long)i * noOfRegions / live.size();
+    regions[region].push_back(live[i]);
+    owners[live[i]->getId()] = region;
+  }
+}
 
-  for (Vertex *vertex : mesh->getVertices()) {
-    for (Face *face : vertex->getFaces()) {
-      // Calculate v0v1
-      x = face->getVertex(1)->getX() - face->getVertex(0)->getX();
-      y = face->getVertex(1)->getY() - face->getVertex(0)->getY();
-      z = face->getVertex(1)->getZ() - face->getVertex(0)->getZ();
-      v0v1.update(x, y, z);
-
-      // Calculate v0v2
-      x = face->getVertex(2)->getX() - face->getVertex(0)->getX();
-      y = face->getVertex(2)->getY() - face->getVertex(0)->getY();
-      z = face->getVertex(2)->getZ() - face->getVertex(0)->getZ();
-      v0v2.update(x, y, z);
-
-      std::unique_ptr<Vector> v(v0v1.cross(&v0v2));
-      // Normalize so that x² + y² + z² = 1
-      v->normalize();
-
-      // Apply v0 to find parameter d of equation
-      d = (v->getX() * face->getVertex(0)->getX()) +
-          (v->getY() * face->getVertex(0)->getY()) +
-          (v->getZ() * face->getVertex(0)->getZ());
-      d *= -1;
-
-      // Initialize plane
-      double plane[4] = {v->getX(), v->getY(), v->getZ(), d};
-
-      // For this plane, the fundamental quadric Kp is the product of vectors
-      // plane and plane'
-      for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-          Kp[i][j] += plane[i] * plane[j];
-        }
+/*
+  Claim-free collapse loop over spatial regions, one thread per region. A
+  collapse writes to its two end points and their neighbours only, so when
+  both end points have all their neighbours in the sampling thread's region
+  no other thread can touch anything it writes. The sampled vertex is checked
+  first, before the adjacency of any other vertex is read: once it is
+  interior, the end points of all its edges are in the region too, and no
+  other thread writes to them. Samples on a border, or whose cheapest edge
+  leads to one, are skipped and counted.
+
+  Every region removes three quarters of the share of the remaining target
+  that falls on its interior, so the mesh is simplified evenly rather than
+  region interiors first: a quota over the whole region would have the
+  interior make up for the border it cannot touch, and a full share would
+  leave the final pass only the costliest edges of the interiors next to
+  untouched borders. A region is given up on after enough consecutive
+  failures that every vertex of it has most likely been sampled. Returns the
+  number of failures.
+*/
+Index QuadricErrorMetrics::collapseInRegions(
+    Index target, int milestone,
+    const std::vector<std::vector<Vertex *>> &regions,
+    const std::vector<int> &owners, Index &progress) {
+  Index failures = 0;
+  std::vector<ContentionReport> &contention = this->report.threads;
+  int noOfRegions = regions.size();
+
+  // Live and interior vertices of every region, as of this milestone
+  std::vector<Index> live(noOfRegions, 0), interior(noOfRegions, 0);
+#pragma omp parallel for
+  for (int i = 0; i < noOfRegions; i++) {
+    for (Vertex *v : regions[i]) {
+      if (!v->isRemoved() && v->hasFaces()) {
+        live[i]++;
+        interior[i] += this->isCrownInCell(v, owners);
       }
-
-      sumQuadrics(vertex->Q, Kp);
     }
   }
+  long long remaining = target - progress;
+  long long noOfVertices = 0;
+  for (Index n : live) {
+    noOfVertices += n;
+  }
 
-  std::cout << "Done" << std::endl;
-}
+#pragma omp parallel for reduction(+ : failures)
+  for (int i = 0; i < noOfRegions; i++) {
+    const std::vector<Vertex *> &region = regions[i];
+    Index tl_length = region.size();
+    Index tl_quota =
+        remaining * interior[i] * 3 / 4 / std::max(noOfVertices, 1LL);
+    long long tl_misses = 0;
+    double tl_maxError = 0.0;
+    unsigned int tl_seed = time(0) + i;
+    ContentionReport tl_contention;
+    TRACE_SCOPE("region", i);
+
+    while (tl_contention.noOfCollapses < tl_quota &&
+           tl_misses <= 4LL * tl_length && progress < target &&
+           !this->isExpired()) {
+      Vertex *tl_v = region[randomIndex(
+          tl_length, [&]() { return rand_r(&tl_seed); })];
+      Index tl_index = tl_v->getId();
+      TELEMETRY_COUNT("samples", 1);
 
-void QuadricErrorMetrics::calculateEdgeCosts(Mesh *mesh) const {
-  std::cout << "Calculating edge costs... ";
+      bool status = false;
+      if (tl_v->isRemoved() || !tl_v->hasFaces()) {
+        if (tl_v->isRemoved()) {
+          tl_contention.noOfRemovedVertices++;
+        } else {
+          tl_contention.noOfBareVertices++;
+        }
+        if (this->heatmap) {
+          this->heatmap->fail(tl_index);
+        }
+      } else {
+        // <tl_v> is checked first: until it is known to be interior, its
+        // neighbours may belong to other regions, whose threads may be
+        // rewiring their adjacency lists
+        Edge *edgeWithMinCost = NULL;
+        if (this->isCrownInCell(tl_v, owners)) {
+          edgeWithMinCost = tl_v->getEdgeWithMinCost();
+          assert(edgeWithMinCost != NULL);
+        }
+        if (!edgeWithMinCost ||
+            !this->isCrownInCell(edgeWithMinCost->getV1() == tl_v
+                                     ? edgeWithMinCost->getV2()
+                                     : edgeWithMinCost->getV1(),
+                                 owners)) {
+          tl_contention.noOfBorderVertices++;
+          if (this->heatmap) {
+            this->heatmap->conflict(tl_index);
+          }
+        } else {
+          double cost = edgeWithMinCost->getCost();
+          Index removedId = edgeWithMinCost->getV1()->getId();
+          if (cost <= this->maxError) {
+            TRACE_SCOPE("collapse");
+            long long tl_t0 = Telemetry::isEnabled() ? Telemetry::now() : 0;
+            status = this->collapseEdge(edgeWithMinCost);
+            if (status && Telemetry::isEnabled()) {
+              tl_contention.latency.add(Telemetry::now() - tl_t0);
+            }
+          }
+          if (status) {
+            tl_maxError = std::max(tl_maxError, cost);
+            if (this->heatmap) {
+              this->heatmap->remove(removedId, omp_get_thread_num(), i,
+                                    milestone);
+            }
+          } else {
+            tl_contention.noOfRejections++;
+            if (this->heatmap) {
+              this->heatmap->fail(tl_index);
+            }
+          }
+        }
+      }
+
+      if (status) {
+        tl_contention.noOfCollapses++;
+#pragma omp atomic
+        progress++;
+        tl_misses = 0;
+      } else {
+        failures++;
+        tl_misses++;
+      }
+    }
 
-  double cost = 0.0;
-  for (Edge *edge : mesh->getEdges()) {
-    double cost = this->calculateEdgeCost(edge);
-    edge->setCost(cost);
+#pragma omp critical
+    {
+      this->report.maxError = std::max(this->report.maxError, tl_maxError);
+      contention[i].merge(tl_contention);
+    }
   }
 
-  std::cout << "Done" << std::endl;
+  return failures;
 }
 
-void QuadricErrorMetrics::simplifyImplementation(Mesh *mesh, float goal,
-                                                 int noOfBlocks = 32,
-                                                 int noOfThreads = 32) {
-  int noOfVertices = mesh->getNoOfVertices();
+void QuadricErrorMetrics::simplifyImplementation(
+    Mesh *mesh, const std::vector<Index> &targets, int noOfThreads = 32,
+    const std::function<void(int)> &milestone = nullptr) {
+  Index noOfVertices = mesh->getNoOfVertices();
+  Index noOfActiveVertices = mesh->getNoOfActiveVertices();
   auto vertices = mesh->getVertices();
 
-  int progress = 0;
-  int failures = 0;
-  int target = goal * noOfVertices;
-  int blockSize = noOfVertices / noOfThreads;
-  std::cout << "Simplifying [target = " << noOfVertices - target
-            << " vertex(s)]... ";
+  Index progress = 0;
+  Index noOfRemovedVertices = this->report.noOfRemovedVertices;
+  Index blockSize = noOfVertices / noOfThreads;
 
-  std::set<Vertex *> globalWorkSet;
+  // Vertices whose neighbourhood a thread is working in, by vertex id
+  std::vector<char> claimed(noOfVertices, 0);
+  std::vector<ContentionReport> &contention = this->report.threads;
+  contention.resize(std::max((int)contention.size(), noOfThreads));
 
   omp_set_num_threads(noOfThreads);
 
-#pragma omp parallel for
-  for (int i = 0; i < noOfThreads; i++) {
-    int tl_startIndex = (blockSize * i);
-    int tl_length =
-        blockSize + ((i == noOfThreads - 1) ? noOfVertices % noOfThreads : 0);
-    assert(tl_startIndex + tl_length <= noOfVertices);
-
-    Vertex *tl_v;
-    std::set<Vertex *> tl_tmpSet;
-    std::set<Vertex *> tl_localWorkSet;
-    std::set<Vertex *> tl_neighbourSet;
-
-    srand(time(0));
-    while (progress < target) {
-      int tl_offset = rand() % tl_length;
-      int tl_index = tl_startIndex + tl_offset;
-      assert(tl_index < noOfVertices);
-
-      tl_v = vertices[tl_index];
-
-      /*
-        Skip this iteration if the selected vertex:
-        1. has already been removed
-        2. has zero faces
-      */
-      if (tl_v->isRemoved() || !tl_v->hasFaces()) {
-#pragma omp atomic
-        failures++;
-        continue;
-      }
+  // Regions are drawn once; vertices keep their ids and owners until write()
+  std::vector<std::vector<Vertex *>> regions;
+  std::vector<int> owners;
+  if (this->partitioning == SPATIAL) {
+    TRACE_SCOPE("partition");
+    this->partitionVertices(mesh, noOfThreads, regions, owners);
+  }
 
-#pragma omp critical
-      {
-        /*
-          1. Check if this is the first iteration of the thread; if so, skip.
-             Otherwise, proceed to the second condition.
-             Note that the neighbour set <tl_neighbourSet> is initially empty.
+  /*
+    One parallel region per milestone: the threads join once <target> vertices
+    have been removed, so the mesh is quiescent while <milestone> runs.
+  */
+  for (int m = 0; m < (int)targets.size(); m++) {
+    bool stopped =
+        this->report.stoppedAtError || this->report.stoppedAtDeadline;
+    Index target = stopped ? progress : targets[m];
+    Index failures = 0;
+    bool exhausted = false;
+    std::cout << "Simplifying [target = " << noOfActiveVertices - target
+              << " vertex(s)]... ";
+
+    // The final INDEX pass below picks up what the regions leave
+    if (!regions.empty()) {
+      failures += this->collapseInRegions(target, m, regions, owners, progress);
+    }
 
-          2. If an edge was collapsed in the previous iteration, remove all
-          its neighboring vertices from the global work set <globalWorkSet>.
+#pragma omp parallel for
+    for (int i = 0; i < noOfThreads; i++) {
+      Index tl_startIndex = (blockSize * i);
+      Index tl_length =
+          blockSize + ((i == noOfThreads - 1) ? noOfVertices % noOfThreads : 0);
+      assert(tl_startIndex + tl_length <= noOfVertices);
+
+      Vertex *tl_v;
+      Edge *tl_edge = NULL;
+      VertexList tl_neighbourhood;
+      bool tl_claimed = false;
+      bool tl_busy = false; // another thread holds part of the neighbourhood
+      long long tl_misses = 0;
+      double tl_maxError = 0.0;
+      unsigned int tl_seed = time(0) + i;
+      ContentionReport tl_contention;
+      TRACE_SCOPE("block", i);
+
+      while (progress < target && !this->isExpired()) {
+        /*
+          With an error bound, a block whose remaining edges all cost too much
+          is never drained. Give up on it after enough consecutive misses that
+          every vertex of the block has most likely been sampled.
         */
-        if (tl_neighbourSet.size() && !tl_tmpSet.size()) {
-          std::set_difference(globalWorkSet.begin(), globalWorkSet.end(),
-                              tl_neighbourSet.begin(), tl_neighbourSet.end(),
-                              std::inserter(tl_tmpSet, tl_tmpSet.begin()));
-          globalWorkSet.swap(tl_tmpSet);
+        if (this->maxError < DBL_MAX && tl_misses > 4LL * tl_length) {
+#pragma omp atomic write
+          exhausted = true;
+          break;
         }
 
-        tl_tmpSet.clear();
-        tl_neighbourSet = tl_v->getNeighbourVertices();
-        std::set_intersection(globalWorkSet.begin(), globalWorkSet.end(),
-                              tl_neighbourSet.begin(), tl_neighbourSet.end(),
-                              std::inserter(tl_tmpSet, tl_tmpSet.begin()));
+        Index tl_offset =
+            randomIndex(tl_length, [&]() { return rand_r(&tl_seed); });
+        Index tl_index = tl_startIndex + tl_offset;
+        assert(tl_index < noOfVertices);
 
-        if (!tl_tmpSet.size())
-          globalWorkSet.insert(tl_neighbourSet.begin(), tl_neighbourSet.end());
-      }
+        tl_v = vertices[tl_index];
+        TELEMETRY_COUNT("samples", 1);
 
-      bool status = false;
-      if (!tl_tmpSet.size()) {
-        Edge *edgeWithMinCost = tl_v->getEdgeWithMinCost();
-        assert(edgeWithMinCost != NULL);
-        status = this->collapseEdge(edgeWithMinCost);
-      }
+        /*
+          Skip this iteration if the selected vertex:
+          1. has already been removed
+          2. has zero faces
+        */
+        if (tl_v->isRemoved() || !tl_v->hasFaces()) {
+          if (tl_v->isRemoved()) {
+            tl_contention.noOfRemovedVertices++;
+          } else {
+            tl_contention.noOfBareVertices++;
+          }
+          if (this->heatmap) {
+            this->heatmap->fail(tl_index);
+          }
+#pragma omp atomic
+          failures++;
+          tl_misses++;
+          continue;
+        }
 
-      if (status) {
+        TraceScope tl_claim("claim");
+        long long tl_t0 = Telemetry::isEnabled() ? Telemetry::now() : 0;
+#pragma omp critical
+        {
+          if (Telemetry::isEnabled()) {
+            tl_contention.waitTime += (Telemetry::now() - tl_t0) / 1e6;
+          }
+
+          /*
+            1. If the previous iteration claimed a neighbourhood, release it.
+
+            2. Unless another thread holds <tl_v>, pick its cheapest edge.
+               The collapse rewires the edges of both end points' neighbours,
+               so claim <tl_v>, the other end point and the neighbours of
+               both, unless another thread holds any of them. The lists of a
+               vertex are only read once it is known to be unclaimed.
+          */
+          if (tl_claimed) {
+            for (Vertex *v : tl_neighbourhood) {
+              claimed[v->getId()] = 0;
+            }
+          }
+
+          tl_claimed = false;
+          tl_edge = NULL;
+          tl_busy = claimed[tl_v->getId()];
+          if (!tl_busy) {
+            tl_edge = tl_v->getEdgeWithMinCost();
+          }
+          if (tl_edge) {
+            const Vertex *tl_w = tl_edge->getV1() == tl_v ? tl_edge->getV2()
+                                                          : tl_edge->getV1();
+            tl_neighbourhood = tl_v->getNeighbourVertices();
+            tl_neighbourhood.push_back(tl_v);
+            tl_neighbourhood.insert((Vertex *)tl_w);
+            tl_claimed = true;
+            for (Vertex *v : tl_neighbourhood) {
+              if (claimed[v->getId()]) {
+                tl_claimed = false;
+                break;
+              }
+            }
+            if (tl_claimed) {
+              for (Vertex *v : tl_w->getNeighbourVertices()) {
+                if (claimed[v->getId()]) {
+                  tl_claimed = false;
+                  break;
+                }
+                tl_neighbourhood.insert(v);
+              }
+            }
+            tl_busy = !tl_claimed;
+          }
+
+          if (tl_claimed) {
+            for (Vertex *v : tl_neighbourhood) {
+              claimed[v->getId()] = 1;
+            }
+          }
+        }
+        tl_claim.stop();
+
+        bool status = false;
+        if (tl_claimed) {
+          Edge *edgeWithMinCost = tl_edge;
+          double cost = edgeWithMinCost->getCost();
+          Index removedId = edgeWithMinCost->getV1()->getId();
+          if (cost <= this->maxError) {
+            TRACE_SCOPE("collapse");
+            tl_t0 = Telemetry::isEnabled() ? Telemetry::now() : 0;
+            status = this->collapseEdge(edgeWithMinCost);
+            if (status && Telemetry::isEnabled()) {
+              tl_contention.latency.add(Telemetry::now() - tl_t0);
+            }
+          }
+          if (status) {
+            tl_maxError = std::max(tl_maxError, cost);
+            if (this->heatmap) {
+              this->heatmap->remove(removedId, omp_get_thread_num(), i, m);
+            }
+          } else {
+            tl_contention.noOfRejections++;
+            if (this->heatmap) {
+              this->heatmap->fail(tl_index);
+            }
+          }
+        } else if (!tl_busy) {
+          // Removed, or left without edges, since it was sampled
+          tl_contention.noOfRemovedVertices++;
+          if (this->heatmap) {
+            this->heatmap->fail(tl_index);
+          }
+        } else {
+          tl_contention.noOfConflicts++;
+          if (this->heatmap) {
+            this->heatmap->conflict(tl_index);
+          }
+        }
+
+        if (status) {
+          tl_contention.noOfCollapses++;
 #pragma omp atomic
-        progress++;
-      } else {
+          progress++;
+          tl_misses = 0;
+        } else {
 #pragma omp atomic
-        failures++;
+          failures++;
+          tl_misses++;
+        }
+      }
+
+#pragma omp critical
+      {
+        // Release the neighbourhood claimed by the last iteration, if any
+        if (tl_claimed) {
+          for (Vertex *v : tl_neighbourhood) {
+            claimed[v->getId()] = 0;
+          }
+        }
+        this->report.maxError = std::max(this->report.maxError, tl_maxError);
+        contention[i].merge(tl_contention);
       }
     }
-  }
 
-  std::cout << "Done [" << failures << " failure(s)]" << std::endl;
+    // Every thread has released its last neighbourhood on the way out
+    this->report.noOfRemovedVertices = noOfRemovedVertices + progress;
+    this->report.noOfFailures += failures;
+    if (progress < target) {
+      this->report.stoppedAtDeadline = this->isExpired();
+      this->report.stoppedAtError = !this->isExpired() && exhausted;
+    }
+
+    std::cout << "Done [" << failures << " failure(s)";
+    if (this->report.stoppedAtDeadline) {
+      std::cout << ", deadline reached";
+    } else if (this->report.stoppedAtError) {
+      std::cout << ", error threshold reached";
+    }
+    std::cout << "]" << std::endl;
+
+    if (milestone) {
+      milestone(m);
+    }
+  }
 }
\ No newline at end of file
@@ -2,41 +2,251 @@
 
 #include <algorithm>
 #include <cassert>
-#include <map>
+#include <functional>
 #include <memory>
 #include <omp.h>
-#include <set>
 
+#include "deadline.h"
+#include "heatmap.h"
 #include "mesh.h"
+#include "placement.h"
+#include "pm.h"
+#include "telemetry.h"
 #include "vector.h"
 
+/*
+  Outcome of the vertices sampled by one thread block of the collapse loop.
+  Waiting and latency are only measured in telemetry builds.
+*/
+struct ContentionReport {
+  Index noOfCollapses = 0;
+  Index noOfRemovedVertices = 0; // sampled vertex was already removed
+  Index noOfBareVertices = 0;    // sampled vertex has no faces left
+  Index noOfConflicts = 0;       // neighbourhood claimed by another thread
+  Index noOfBorderVertices = 0;  // region border, left for the final pass
+  Index noOfRejections = 0;      // over the error bound, or collapse refused
+  double waitTime = 0.0; // ms spent waiting to enter the critical section
+  Histogram latency;     // of successful collapses
+
+  void merge(const ContentionReport &c) {
+    this->noOfCollapses += c.noOfCollapses;
+    this->noOfRemovedVertices += c.noOfRemovedVertices;
+    this->noOfBareVertices += c.noOfBareVertices;
+    this->noOfConflicts += c.noOfConflicts;
+    this->noOfBorderVertices += c.noOfBorderVertices;
+    this->noOfRejections += c.noOfRejections;
+    this->waitTime += c.waitTime;
+    this->latency.merge(c.latency);
+  }
+
+  Index getNoOfFailures() const {
+    return this->noOfRemovedVertices + this->noOfBareVertices +
+           this->noOfConflicts + this->noOfBorderVertices +
+           this->noOfRejections;
+  }
+};
+
+/* How far the last simplification got, and where its time went */
+struct SimplifyReport {
+  Index noOfRemovedVertices = 0;
+  Index noOfFailures = 0; // sampled vertices that did not lead to a collapse
+  double maxError = 0.0; // largest cost of an applied collapse
+  bool stoppedAtError = false;
+  bool stoppedAtDeadline = false;
+
+  // Wall time of every phase, in milliseconds
+  double quadricsTime = 0.0;
+  double clusteringTime = 0.0;
+  double edgeCostsTime = 0.0;
+  double simplifyTime = 0.0;
+
+  std::vector<ContentionReport> threads; // one per thread block
+};
+
 class QuadricErrorMetrics {
+public:
+  /*
+    How the collapse loop splits the mesh among threads. INDEX gives each
+    thread a range of vertex ids and claims neighbourhoods in a critical
+    section. SPATIAL gives each thread a compact region, a run of the
+    Hilbert curve, which it simplifies without claims wherever the collapse
+    stays inside the region; the region borders are left to a final INDEX
+    pass.
+  */
+  enum Partition { INDEX, SPATIAL };
+
+private:
+  ProgressiveMesh *progressiveMesh;
+  Heatmap *heatmap;
+  double maxError;
+  const Deadline *deadline;
+  Partition partitioning;
+  Placement::Policy placementPolicy;
+  SimplifyReport report;
+
   QuadricErrorMetrics();
   QuadricErrorMetrics(const QuadricErrorMetrics &) = delete;
 
+  friend class MeshBenchmarks;
+
   static QuadricErrorMetrics *getInstance() {
     static QuadricErrorMetrics qem;
     return &qem;
   }
 
+  /* Run <phase> as telemetry phase <name>; returns its time in ms */
+  template <typename Phase>
+  static double timed(const char *name, Phase phase) {
+    ScopedPhase scope(name);
+    phase();
+    return scope.stop();
+  }
+
+  bool isExpired() const {
+    return this->deadline && this->deadline->isExpired();
+  }
+
   double calculateError(const Vertex *) const;
-  void sumQuadrics(double a[4][4], const double b[4][4]) const;
-  double calculateEdgeCost(const Edge *) const;
+  void calculateEdgeCosts(Edge *const *, Index) const;
 
   bool collapseEdge(Edge *);
+  bool isCrownInCell(const Vertex *, const std::vector<int> &) const;
 
   void calculateQuadrics(Mesh *) const;
   void calculateEdgeCosts(Mesh *) const;
-  void simplifyImplementation(Mesh *, float, int, int);
+  double calculateMeshError(const Mesh *) const;
+  Index clusterVertices(Mesh *, Index, int, int);
+  void partitionVertices(const Mesh *, int,
+                         std::vector<std::vector<Vertex *>> &,
+                         std::vector<int> &) const;
+  Index collapseInRegions(Index, int,
+                          const std::vector<std::vector<Vertex *>> &,
+                          const std::vector<int> &, Index &);
+  void simplifyImplementation(Mesh *, const std::vector<Index> &, int,
+                              const std::function<void(int)> &);
 
 public:
-  static void simplify(Mesh *mesh, float goal = 0.5, int noOfBlocks = 32,
-                       int noOfThreads = 32) {
+  /* Quadric math, shared with the streaming simplifier */
+  static double calculateError(const QuadricScalar v[4], const Quadric Q);
+  static void sumQuadrics(Quadric a, const Quadric b);
+  static void calculatePlaneQuadric(const double p0[3], const double p1[3],
+                                    const double p2[3], Quadric Kp);
+
+  static void simplify(Mesh *mesh, float goal = 0.5, int noOfThreads = 32) {
+    QuadricErrorMetrics *qem = getInstance();
+    SimplifyReport &report = qem->report = SimplifyReport();
+    std::cout << std::endl;
+    report.quadricsTime =
+        timed("quadrics", [&]() { qem->calculateQuadrics(mesh); });
     std::cout << std::endl;
-    getInstance()->calculateQuadrics(mesh);
+    report.edgeCostsTime =
+        timed("edge-costs", [&]() { qem->calculateEdgeCosts(mesh); });
     std::cout << std::endl;
-    getInstance()->calculateEdgeCosts(mesh);
+    report.simplifyTime = timed("simplify", [&]() {
+      qem->simplifyImplementation(
+          mesh, {(Index)((double)goal * mesh->getNoOfVertices())}, noOfThreads,
+          nullptr);
+    });
+  }
+
+  /*
+    Level-of-detail chain from a single pass: simplify toward the last of the
+    ascending <goals> and call <milestone>(i) from the calling thread as soon
+    as <goals>[i] of the vertices have been removed. The mesh is not being
+    modified while <milestone> runs.
+  */
+  static void simplifyChain(Mesh *mesh, const std::vector<float> &goals,
+                            const std::function<void(int)> &milestone,
+                            int noOfThreads = 32) {
+    std::vector<Index> targets;
+    for (float goal : goals) {
+      targets.push_back((double)goal * mesh->getNoOfVertices());
+    }
+    QuadricErrorMetrics *qem = getInstance();
+    SimplifyReport &report = qem->report = SimplifyReport();
     std::cout << std::endl;
-    getInstance()->simplifyImplementation(mesh, goal, noOfBlocks, noOfThreads);
+    report.quadricsTime =
+        timed("quadrics", [&]() { qem->calculateQuadrics(mesh); });
+    std::cout << std::endl;
+    report.edgeCostsTime =
+        timed("edge-costs", [&]() { qem->calculateEdgeCosts(mesh); });
+    std::cout << std::endl;
+    report.simplifyTime = timed("simplify", [&]() {
+      qem->simplifyImplementation(mesh, targets, noOfThreads, milestone);
+    });
+  }
+
+  /*
+    Two-stage simplification: a parallel grid vertex-clustering pass merges
+    the vertices of every occupied cell into one, carrying their summed
+    quadric, on the coarsest grid that removes up to <intermediate> of the
+    vertices (searched from <noOfBlocks> cells to a side); QEM then finishes
+    to <goal> using those inherited quadrics.
+  */
+  static void simplifyHybrid(Mesh *mesh, float goal = 0.9,
+                             float intermediate = 0.75, int noOfBlocks = 32,
+                             int noOfThreads = 32) {
+    Index target = (double)goal * mesh->getNoOfVertices();
+    QuadricErrorMetrics *qem = getInstance();
+    SimplifyReport &report = qem->report = SimplifyReport();
+    Index clustered = 0;
+    std::cout << std::endl;
+    report.quadricsTime =
+        timed("quadrics", [&]() { qem->calculateQuadrics(mesh); });
+    std::cout << std::endl;
+    report.clusteringTime = timed("clustering", [&]() {
+      clustered = qem->clusterVertices(
+          mesh, (double)intermediate * mesh->getNoOfVertices(), noOfBlocks,
+          noOfThreads);
+    });
+    std::cout << std::endl;
+    report.edgeCostsTime =
+        timed("edge-costs", [&]() { qem->calculateEdgeCosts(mesh); });
+    std::cout << std::endl;
+    report.simplifyTime = timed("simplify", [&]() {
+      qem->simplifyImplementation(mesh, {target - clustered}, noOfThreads,
+                                  nullptr);
+    });
+  }
+
+  /* Log every subsequent collapse to <pm>; NULL stops logging */
+  static void record(ProgressiveMesh *pm) {
+    getInstance()->progressiveMesh = pm;
+  }
+
+  /* Thread partitioning of the collapse loop in subsequent runs */
+  static void partition(Partition partitioning) {
+    getInstance()->partitioning = partitioning;
+  }
+
+  /*
+    Where subsequent runs place the surviving vertex of a collapse, and so
+    what the collapse costs (placement.h)
+  */
+  static void placement(Placement::Policy placementPolicy) {
+    getInstance()->placementPolicy = placementPolicy;
+  }
+
+  /* Collect per-vertex diagnostics of subsequent runs; NULL stops them */
+  static void diagnose(Heatmap *heatmap) {
+    getInstance()->heatmap = heatmap;
+  }
+
+  /*
+    Stop criteria for subsequent runs besides the vertex target: collapses
+    costing more than <maxError> are rejected, and the run ends once
+    <deadline> expires, leaving the mesh as it is at that point. DBL_MAX and
+    NULL disable them.
+  */
+  static void limit(double maxError, const Deadline *deadline) {
+    getInstance()->maxError = maxError;
+    getInstance()->deadline = deadline;
+  }
+
+  static const SimplifyReport &getReport() { return getInstance()->report; }
+
+  /* Sum of v'Qv over the remaining vertices */
+  static double error(const Mesh *mesh) {
+    return getInstance()->calculateMeshError(mesh);
   }
 };
@@ -0,0 +1,97 @@
+#ifndef COSTS_H__
+#define COSTS_H__
+
+#include "../placement.h"
+#include "Classes.h"
+#include "common.h"
+
+// Cost policies of SimpDriver (SimpDriver.h). A policy is a stateless struct
+// with
+//   QUADRICS       whether the driver keeps a quadric per vertex: builds them
+//                  before the edges and sums p1's into p2's on collapse
+//   getCost(e)     moves e->placement to where p2 goes if e collapses, and
+//                  returns the cost of collapsing e
+// Everything is static and inline, so the driver instantiated on a policy
+// compiles its cost code into the collapse loop, without virtual calls.
+
+// v'Qv of a homogeneous point v
+inline double getError(const double v[4], const double Q[4][4]) {
+  double vQ[4] = {0};
+  double cost = 0;
+
+  // vT(row vector) dot Q (4x4 matrix)
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      vQ[i] += v[j] * Q[j][i];
+    }
+  }
+  // vQ (row vector) dot v (column vector)
+  for (int i = 0; i < 4; ++i) {
+    cost += vQ[i] * v[i];
+  }
+  return cost;
+}
+
+inline void setMidpoint(Edge *e) {
+  e->placement->x = (e->p1->x + e->p2->x) / 2;
+  e->placement->y = (e->p1->y + e->p2->y) / 2;
+  e->placement->z = (e->p1->z + e->p2->z) / 2;
+}
+
+// Error of p's quadric at p
+inline double getPointError(Point *p) {
+  double v[4] = {p->x, p->y, p->z, 1};
+  return getError(v, p->Q);
+}
+
+// Squared edge length, collapsing to the midpoint
+struct ElenCost {
+  static const bool QUADRICS = false;
+
+  static double getCost(Edge *e) {
+    setMidpoint(e);
+    double dx = e->p1->x - e->p2->x;
+    double dy = e->p1->y - e->p2->y;
+    double dz = e->p1->z - e->p2->z;
+    return dx * dx + dy * dy + dz * dz;
+  }
+};
+
+// Quadric error (Garland, 97) of collapsing to the midpoint
+struct QemMidpointCost {
+  static const bool QUADRICS = true;
+
+  static double getCost(Edge *e) {
+    setMidpoint(e);
+    // Error cost is given by vTQv where v is the placement vertex
+    copyQuadrics(e->placement->Q, e->p1->Q);
+    sumQuadrics(e->placement->Q, e->p2->Q);
+    return getPointError(e->placement);
+  }
+};
+
+// Quadric error of collapsing to the point that minimizes it, placed by
+// Placement::OPTIMAL (../placement.h) as in the top-level QEM engine, in
+// double whatever the precision of the top-level build
+struct QemOptimalCost {
+  static const bool QUADRICS = true;
+
+  static double getCost(Edge *e) {
+    double(*Q)[4] = e->placement->Q;
+    copyQuadrics(Q, e->p1->Q);
+    sumQuadrics(Q, e->p2->Q);
+
+    typedef BasicPlacement<double, double> Placement;
+    Placement placement;
+    double p1[3] = {e->p1->x, e->p1->y, e->p1->z};
+    double p2[3] = {e->p2->x, e->p2->y, e->p2->z};
+    placement.add(Q, p1, p2);
+    placement.solve(Placement::OPTIMAL);
+    e->placement->x = placement.getX(0);
+    e->placement->y = placement.getY(0);
+    e->placement->z = placement.getZ(0);
+    return placement.getCost(0);
+  }
+};
+
+#endif // COSTS_H__
@@ -8,32 +8,88 @@
 
 using namespace std;
 
-long long int getMilliseconds(timespec t) {
-  return t.tv_sec * 1000 + t.tv_nsec / 1000000;
-}
-
-long long int getNanoseconds(timespec t) {
-  return (1000000000 * t.tv_sec) + t.tv_nsec;
+// Run one of the quadric engines with the stop criteria and diagnostics, and
+// report it to the telemetry
+template <class Simp>
+void simplifyQEM(Surface *s, float goal, int gridresolution, int nthreads,
+                 double max_error, long long budget, const char *heatmap_file,
+                 Heatmap::Channel heatmap_channel) {
+  ScopedPhase total("total");
+  int goal_vertices = goal * s->m_points.size();
+  Simp *qem = new Simp(s, nthreads);
+  Deadline deadline(budget);
+  qem->max_error = max_error > 0 ? max_error : DBL_MAX;
+  qem->deadline = &deadline;
+  if (heatmap_file) {
+    vector<double> positions;
+    for (Point *p : s->m_points)
+      positions.insert(positions.end(), {p->x, p->y, p->z});
+    vector<int> triangles;
+    for (Face *f : s->m_faces)
+      for (Point *p : f->points)
+        triangles.push_back(p->id);
+    qem->heatmap = new Heatmap(positions, triangles);
+  }
+  qem->simplify(goal_vertices, gridresolution);
+  double total_time = total.stop();
+  cout << lightgreentty << "TOTAL TIME: " << (long)total_time << " ms"
+       << deftty << endl;
+  Telemetry::get().setValue("removed_vertices", qem->vertices_removed);
+  Telemetry::get().setValue("failed_pops", qem->failed_pop);
+  Telemetry::get().setValue("failed_pops_removed", qem->failed_removed);
+  Telemetry::get().setValue("failed_pops_cost", qem->failed_cost);
+  Telemetry::get().setValue("cell_imbalance", qem->cell_imbalance);
+  Telemetry::get().setValue("thread_imbalance", qem->thread_imbalance);
+  Telemetry::get().setValue("max_error", qem->max_cost);
+  Telemetry::get().setValue("threads", nthreads);
+  Telemetry::get().setValue("total_ms", total_time);
+  if (qem->heatmap && !qem->heatmap->save(heatmap_file, heatmap_channel)) {
+    cerr << "ERROR: Unable to create " << heatmap_file << ".\n";
+    exit(1);
+  }
 }
 
 int main(int argc, char **argv) {
   if (argc < 6) {
     cerr << "*USAGE: Simplify <input file> <fraction of points to remove> "
-            "<method (elen/qem/vc)> <grid_resolution> <no of threads>.\n";
+            "<method (elen/qem/qem-optimal/vc)> <grid_resolution> "
+            "<no of threads> "
+            "[max error (qem)] [deadline in ms (qem)] "
+            "[telemetry json file|-] [trace json file|-] "
+            "[heatmap coff file (qem)] [heatmap channel (qem)].\n";
     exit(1);
   }
 
   string method = argv[3];
 
-  if (method != "elen" && method != "qem" && method != "vc") {
+  if (method != "elen" && method != "qem" && method != "qem-optimal" &&
+      method != "vc") {
     cerr << "ERROR: Invalid decimation method.\n";
     exit(1);
   }
 
-  Surface *s = new Surface(argv[1]);
   float goal = atof(argv[2]);
   int gridresolution = atoi(argv[4]);
   int nthreads = atoi(argv[5]);
+  double max_error = argc > 6 ? atof(argv[6]) : DBL_MAX;
+  long long budget = argc > 7 ? atoll(argv[7]) : 0;
+  const char *telemetry_file =
+      argc > 8 && string(argv[8]) != "-" ? argv[8] : NULL;
+  const char *trace_file =
+      argc > 9 && string(argv[9]) != "-" ? argv[9] : NULL;
+  const char *heatmap_file = argc > 10 ? argv[10] : NULL;
+  Heatmap::Channel heatmap_channel = Heatmap::FAILURES;
+  if (argc > 11 && !Heatmap::parseChannel(argv[11], heatmap_channel)) {
+    cerr << "ERROR: Invalid heatmap channel (failures, conflicts, thread, "
+            "cell, round or order).\n";
+    exit(1);
+  }
+
+  if (telemetry_file && !PerfCounters::get().enable(nthreads))
+    cerr << "Warning: hardware counters unavailable, phases get times only.\n";
+  if (trace_file)
+    Tracer::get().enable();
+  Surface *s = new Surface(argv[1]);
 
   //  Vector3f v1(1,0,0);
   //  Vector3f v2(0,1,0);
@@ -55,16 +111,13 @@ int main(int argc, char **argv) {
     // elen->initEdgeCosts();
     elen->simplify(goal_vertices, gridresolution);
   } else if (method == "qem") {
-    timespec t0, t1, t;
-    clock_gettime(CLOCK_REALTIME, &t0);
     method = "QEM";
-    int goal_vertices = goal * s->m_points.size();
-    SimpQEM *qem = new SimpQEM(s, nthreads);
-    qem->simplify(goal_vertices, gridresolution);
-    clock_gettime(CLOCK_REALTIME, &t1);
-    t = diff(t0, t1);
-    cout << lightgreentty << "TOTAL TIME: " << getMilliseconds(t) << " ms"
-         << deftty << endl;
+    simplifyQEM<SimpQEM>(s, goal, gridresolution, nthreads, max_error, budget,
+                         heatmap_file, heatmap_channel);
+  } else if (method == "qem-optimal") {
+    method = "QEMOPT";
+    simplifyQEM<SimpQEMOptimal>(s, goal, gridresolution, nthreads, max_error,
+                                budget, heatmap_file, heatmap_channel);
   } else if (method == "vc") {
     method = "VCLUSTERING";
     cout << "Vertex Clustering not available yet.\n";
@@ -97,6 +150,15 @@ int main(int argc, char **argv) {
        << s->bbox.getZLen() << endl;
   cerr << deftty;
 
+  if (telemetry_file && !Telemetry::get().save(telemetry_file)) {
+    cerr << "ERROR: Unable to create " << telemetry_file << ".\n";
+    exit(1);
+  }
+  if (trace_file && !Tracer::get().save(trace_file)) {
+    cerr << "ERROR: Unable to create " << trace_file << ".\n";
+    exit(1);
+  }
+
   // delete vc;
   delete s;
 
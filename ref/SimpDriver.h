@@ -0,0 +1,457 @@
+#ifndef SIMPDRIVER_H__
+#define SIMPDRIVER_H__
+
+#include "Costs.h"
+#include "Surface.h"
+#include "../deadline.h"
+#include "../heatmap.h"
+#include "../telemetry.h"
+#include <algorithm>
+#include <float.h>
+#include <omp.h>
+#include <string.h>
+
+// Uniform-grid parallel edge-collapse simplifier, templated on the cost
+// policy of Costs.h: rounds of independent per-cell priority queues, from a
+// grid of gridres^3 cells down to a single cell. SimpELEN (SimpELEN.h) and
+// SimpQEM (SimpQEM.h) are instantiations of it; the loop, the stop criteria
+// and the reports are the same for every policy.
+template <class Cost> class SimpDriver {
+public:
+  typedef Cost CostPolicy;
+
+  // Attributes
+  Surface *s;
+  priority_queue<Edge> edge_queue;
+  vector<double> currentEdgeCost;
+  vector<pair<int, int>> currentEdgePoints;
+  int *initial_vertices; // How many vertices are initially inside each
+                         // uniformgrid cell
+
+  vector<Point *> *cell;           // Uniform grid cells
+  priority_queue<Edge> *cell_queue; // Priority_queue for each cell in the grid
+
+  int failed_pop;
+  int failed_removed;
+  int failed_cost;
+
+  int grid_res; // grid has N x N x N cells
+  int n_cells;
+  double dim[3]; // dimension of the grid x,y,z
+  int total_edges = 0;
+  int nthreads; // Number of OpenMP threads to run
+
+  // Phase times of the last run in ms; finer counters go to ../telemetry.h
+  double time_init = 0;     // Quadrics and edge costs
+  double time_grid = 0;     // Building the uniform grids
+  double time_simplify = 0; // Collapse rounds, grids included
+
+  // Stop criteria besides the vertex goal
+  double max_error = DBL_MAX; // Stop a cell once its cheapest edge costs more
+  const Deadline *deadline = NULL; // Stop every cell once it expires
+
+  // Per-vertex diagnostics of the next run, collected when set
+  Heatmap *heatmap = NULL;
+
+  // Report of the last run
+  int vertices_removed = 0;
+  double max_cost = 0; // Largest cost of a collapsed edge
+  bool stopped_error = false;
+  bool stopped_deadline = false;
+  // Worst round: max over mean busy time of the cells and threads that worked
+  double cell_imbalance = 0;
+  double thread_imbalance = 0;
+
+  // Methods
+  SimpDriver(Surface *, int = 0);
+  ~SimpDriver();
+
+  // Operations
+  void initQuadrics(); // Initialize quadric matrix for every vertex
+  void initEdgeCosts(); // Compute initial costs and constructs edge_queue
+  void updateEdgeCosts(Point *v, int c); // Update costs for v in cell c
+  void simplify(int, int = 1);
+
+  double getCost(Edge *e) { // Updates the placement and cost for edge e
+    TELEMETRY_COUNT("cost_evaluations", 1);
+    return Cost::getCost(e);
+  }
+  double getCost(Point *p) { return getPointError(p); } // Error of p's quadric
+  static double getImbalance(const vector<double> &busy);
+
+  // UNIFORM GRID
+  void initUniformGrid(int res);
+  int getGridCell(Point *p);
+  bool isCrownInCell(Point *p); // Checks whether p's crown (neighbours) is
+                                // inside the same cell as p
+  bool isEntirelyInCell(Edge *e);
+};
+
+template <class Cost> SimpDriver<Cost>::SimpDriver(Surface *so, int nt) {
+  s = so;
+  nthreads = nt;
+  cell = NULL;
+  cell_queue = NULL;
+  initial_vertices = NULL;
+}
+
+template <class Cost> SimpDriver<Cost>::~SimpDriver() {
+  delete[] cell;
+  delete[] cell_queue;
+  delete[] initial_vertices;
+}
+
+// Get cell number which p belongs to. Optimal placements can leave the
+// bounding box of the input, points outside it go to the nearest cell, and
+// so do all points along a dimension of zero length (0/0)
+template <class Cost> int SimpDriver<Cost>::getGridCell(Point *p) {
+  double last = grid_res - 1;
+  double tx = (p->x - s->bbox.minx) / dim[0]; // x
+  int cx = tx > 0 ? min(tx, last) : 0;
+  double ty = (p->y - s->bbox.miny) / dim[1]; // y
+  int cy = ty > 0 ? min(ty, last) : 0;
+  double tz = (p->z - s->bbox.minz) / dim[2]; // z
+  int cz = tz > 0 ? min(tz, last) : 0;
+  return cx + grid_res * cy + grid_res * grid_res * cz;
+}
+
+template <class Cost> bool SimpDriver<Cost>::isEntirelyInCell(Edge *e) {
+  return getGridCell(e->p1) == getGridCell(e->p2);
+}
+
+template <class Cost> bool SimpDriver<Cost>::isCrownInCell(Point *p) {
+  int c = getGridCell(p); // Get p's cell id
+  for (edge_vec_it eit = p->from.begin(); eit != p->from.end(); ++eit) {
+    // Only test for p2 because edges FROM p have p as p1
+    if (getGridCell((*eit)->p2) != c)
+      return false;
+  }
+  for (edge_vec_it eit = p->to.begin(); eit != p->to.end(); ++eit) {
+    // Only test for p1 because edges TO p have p as p2
+    if (getGridCell((*eit)->p1) != c)
+      return false;
+  }
+  return true;
+}
+
+template <class Cost> void SimpDriver<Cost>::initUniformGrid(int res) {
+  // Cellsize for each dimension
+  dim[0] = s->bbox.getXLen() / res;
+  dim[1] = s->bbox.getYLen() / res;
+  dim[2] = s->bbox.getZLen() / res;
+
+  grid_res = res;
+  n_cells = grid_res * grid_res * grid_res;
+  int ncells = n_cells;
+  cerr << "Allocating ncells \n";
+  cerr << "grid_res " << grid_res << endl;
+  cerr << "Ncells " << n_cells << endl;
+  cerr << "Cell Dimensions " << dim[0] << " " << dim[1] << " " << dim[2]
+       << endl;
+
+  // Release the grid of the previous round
+  delete[] cell;
+  delete[] cell_queue;
+  delete[] initial_vertices;
+  cell = new vector<Point *>[n_cells];
+  cell_queue = new priority_queue<Edge>[n_cells];
+  initial_vertices = new int[n_cells];
+
+  for (int i = 0; i < s->m_points.size(); ++i) {
+    unsigned long int cellpos = getGridCell(s->m_points[i]);
+    cell[cellpos].push_back(s->m_points[i]);
+  }
+
+  omp_set_num_threads(nthreads);
+#pragma omp parallel for
+  for (int i = 0; i < ncells; ++i) {
+    initial_vertices[i] = cell[i].size();
+    for (point_vec_it pit = cell[i].begin(); pit != cell[i].end(); ++pit) {
+      for (edge_vec_it eit = (*pit)->from.begin(); eit != (*pit)->from.end();
+           ++eit) {
+        // Check if edge is entirely in cell and so are the endpoint crowns
+        if (isEntirelyInCell(*eit) && isCrownInCell((*eit)->p1) &&
+            isCrownInCell((*eit)->p2)) {
+          cell_queue[i].push(*(*eit));
+        }
+      }
+    }
+  }
+}
+
+template <class Cost> void SimpDriver<Cost>::initQuadrics() {
+  ScopedPhase quadrics("quadrics");
+  // Quadric Q (4x4 matrix) is the sum of all planes tangent to a vertex v
+  // (Garland, 97). Get planes of every vertex faces
+  for (point_vec_it pit = s->m_points.begin(); pit != s->m_points.end();
+       ++pit) {
+    memset((*pit)->Q, 0, sizeof((*pit)->Q));
+    double Kp[4][4];
+    // Get each faces plane
+    for (face_vec_it fit = (*pit)->faces.begin(); fit != (*pit)->faces.end();
+         ++fit) {
+      Point *p0 = (*fit)->points[0];
+      Point *p1 = (*fit)->points[1];
+      Point *p2 = (*fit)->points[2];
+      Vec3 v0{p0->x, p0->y, p0->z};
+      Vec3 v0v1 = Vec3{p1->x, p1->y, p1->z} - v0;
+      Vec3 v0v2 = Vec3{p2->x, p2->y, p2->z} - v0;
+
+      // Normalize so that x² + y² + z² = 1, and apply v0 to find parameter d
+      Vec3 vv = normalize(cross(v0v1, v0v2));
+      Vec4 plane_v = plane(vv, v0);
+      double plane_eq[4] = {plane_v.x, plane_v.y, plane_v.z, plane_v.w};
+
+      // For this plane, the fundamental quadric Kp is the product of vectors
+      // plane_eq and plane_eq(transposed) (garland97)
+      for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+          Kp[i][j] = plane_eq[i] * plane_eq[j];
+        }
+      }
+
+      sumQuadrics((*pit)->Q, Kp);
+    }
+  }
+}
+
+template <class Cost> void SimpDriver<Cost>::initEdgeCosts() {
+  TRACE_SCOPE("edge-costs");
+  cerr << "Init edges.\n";
+  // Iterate over every face generating respective edges
+  int eid = 0;
+
+  // avoid duplicates by only creating edges such that v1->id < v2->id
+  for (vector<Face *>::iterator it = s->m_faces.begin(); it != s->m_faces.end();
+       ++it) {
+    std::vector<Point *> vec;
+    vec.push_back((*it)->points[0]);
+    vec.push_back((*it)->points[1]);
+    vec.push_back((*it)->points[2]);
+    std::sort(vec.begin(), vec.end());
+
+    int v[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+
+    // We'll have half-edges vec(0,1) vec(0,2) vec(1,2)
+    for (int i = 0; i < 3; ++i) {
+
+      Edge *eaux = new Edge(vec[v[i][0]], vec[v[i][1]]);
+      bool found_edge = false;
+      for (edge_vec_it eit = eaux->p1->from.begin();
+           eit != eaux->p1->from.end(); ++eit) {
+        if ((*eit)->p2->id == eaux->p2->id) {
+          found_edge = true;
+          // Add this face to the edge
+          (*eit)->addFace(*it);
+          continue;
+        }
+      }
+      if (!found_edge) {
+        eaux->id = eid;
+        eaux->cost = getCost(eaux);
+        eaux->addFace(*it);
+        edge_queue.push(*eaux);
+        eaux->p1->from.push_back(eaux);
+        eaux->p2->to.push_back(eaux);
+        currentEdgeCost.push_back(eaux->cost);
+        currentEdgePoints.push_back(pair<int, int>(eaux->p1->id, eaux->p2->id));
+        s->m_edges.push_back(eaux);
+        s->is_edge_removed.push_back(false);
+        eid++;
+      }
+    }
+  }
+  total_edges = eid;
+  cerr << "Edges: " << total_edges << endl;
+}
+
+template <class Cost>
+void SimpDriver<Cost>::updateEdgeCosts(Point *v, int i) {
+  TELEMETRY_COUNT("edges_outdated", v->from.size() + v->to.size());
+
+  vector<Edge *> *lists[2] = {&v->from, &v->to};
+  for (vector<Edge *> *list : lists) {
+    for (vector<Edge *>::iterator eit = list->begin(); eit != list->end();
+         ++eit) {
+      if (isEntirelyInCell(*eit) && isCrownInCell((*eit)->p1) &&
+          isCrownInCell((*eit)->p2)) {
+        (*eit)->cost = getCost((*eit));
+        currentEdgeCost[(*eit)->id] = (*eit)->cost;
+        cell_queue[i].push(*(*eit));
+      }
+    }
+  }
+}
+
+template <class Cost>
+double SimpDriver<Cost>::getImbalance(const vector<double> &busy) {
+  double sum = 0, worst = 0;
+  int n = 0;
+  for (double b : busy) {
+    if (b > 0) {
+      sum += b;
+      worst = max(worst, b);
+      n++;
+    }
+  }
+  return n ? worst / (sum / n) : 0;
+}
+
+template <class Cost> void SimpDriver<Cost>::simplify(int goal, int gridres) {
+
+  cerr << "Initializing edge costs.\n";
+  failed_pop = 0;
+  failed_removed = 0;
+  failed_cost = 0;
+  time_grid = 0;
+  cell_imbalance = 0;
+  thread_imbalance = 0;
+  {
+    ScopedPhase init("init");
+    if (Cost::QUADRICS)
+      initQuadrics();
+    initEdgeCosts();
+    time_init = init.stop();
+  }
+  cout << greentty << "Time_init_edges: " << (long)time_init << deftty << endl;
+  vertices_removed = 0;
+  max_cost = 0;
+  stopped_error = false;
+  stopped_deadline = false;
+  cerr << orangetty << "Target vertex count: " << s->m_points.size() - goal
+       << deftty << endl;
+
+  ScopedPhase rounds("simplify");
+  for (int round_no = 0;
+       vertices_removed < goal && !(deadline && deadline->isExpired());
+       round_no++) {
+    int round_removed = vertices_removed;
+    ScopedPhase round("round");
+    double round_grid;
+    {
+      ScopedPhase grid("grid");
+      initUniformGrid(gridres);
+      round_grid = grid.stop();
+    }
+    time_grid += round_grid;
+    cout << greentty << "Grid: " << gridres << endl;
+    cout << lightcyantty << "Removed: " << vertices_removed << endl;
+    cout << lightgreentty << "Time_init_grid: " << (long)round_grid << deftty
+         << endl;
+
+    omp_set_num_threads(nthreads);
+
+    // Busy time of every cell and thread this round, for the imbalance
+    vector<double> cell_time(n_cells, 0.0);
+    vector<double> thread_time(omp_get_max_threads(), 0.0);
+
+#pragma omp parallel for
+    for (int i = 0; i < n_cells; ++i) {
+      int vr = 0;
+      if (cell[i].empty() || cell_queue[i].empty())
+        continue;
+      TRACE_SCOPE("cell", i);
+      long long cell_t0 = Telemetry::now();
+
+      double cell_max_cost = 0;
+      int cell_failures = 0; // Popped edges that did not lead to a collapse
+      int cell_removed = 0;  // Stale pops of edges removed since queued
+      int cell_cost = 0;     // Stale pops of edges whose cost has changed
+      while (vr < initial_vertices[i] / gridres && vertices_removed < goal &&
+             !cell_queue[i].empty() && !(deadline && deadline->isExpired())) {
+
+        Edge e = cell_queue[i].top();
+        cell_queue[i].pop();
+
+        // Skip edge if it's been removed or its cost has changed.
+        if (s->is_edge_removed[e.id] || e.cost != currentEdgeCost[e.id] ||
+            e.p1->faces.empty() || e.p2->faces.empty()) {
+          if (s->is_edge_removed[e.id])
+            cell_removed++;
+          else if (e.cost != currentEdgeCost[e.id])
+            cell_cost++;
+          cell_failures++;
+          if (heatmap)
+            heatmap->fail(e.p1->id);
+          continue;
+        }
+
+        // Queue is ordered by cost, so nothing left in this cell is cheaper
+        if (e.cost > max_error)
+          break;
+
+        double tempQ[4][4];
+        if (Cost::QUADRICS) {
+          copyQuadrics(tempQ, e.p1->Q);
+          sumQuadrics(tempQ, e.p2->Q);
+        }
+        bool collapsed = s->collapse(e);
+        if (collapsed) {
+          if (heatmap)
+            heatmap->remove(e.p1->id, omp_get_thread_num(), i, round_no);
+
+          if (Cost::QUADRICS)
+            copyQuadrics(e.p2->Q, tempQ);
+          vr++;
+          {
+            TELEMETRY_TIMER("update_ns");
+            updateEdgeCosts(e.p2, i);
+          }
+          currentEdgeCost[e.id] = INF; // Edge has been removed
+          cell_max_cost = max(cell_max_cost, e.cost);
+#pragma omp atomic
+          vertices_removed++;
+        } else {
+          TELEMETRY_COUNT("failed_collapses", 1);
+          cell_failures++;
+          if (heatmap)
+            heatmap->fail(e.p1->id);
+        }
+      }
+      cell_time[i] = (Telemetry::now() - cell_t0) / 1e6;
+      thread_time[omp_get_thread_num()] += cell_time[i];
+      TELEMETRY_COUNT("stale_pops_removed", cell_removed);
+      TELEMETRY_COUNT("stale_pops_cost", cell_cost);
+#pragma omp critical
+      {
+        max_cost = max(max_cost, cell_max_cost);
+        failed_pop += cell_failures;
+        failed_removed += cell_removed;
+        failed_cost += cell_cost;
+      }
+    }
+
+    double round_cells = getImbalance(cell_time);
+    double round_threads = getImbalance(thread_time);
+    cell_imbalance = max(cell_imbalance, round_cells);
+    thread_imbalance = max(thread_imbalance, round_threads);
+    cout << purpletty << "Imbalance (max/mean busy time): cells "
+         << round_cells << " - threads " << round_threads << deftty << endl;
+    // A round on the coarsest grid that removed nothing will not progress
+    if (gridres == 1 && vertices_removed == round_removed)
+      break;
+    if (gridres >= 2)
+      gridres /= 2;
+  }
+  if (vertices_removed < goal) {
+    stopped_deadline = deadline && deadline->isExpired();
+    stopped_error = !stopped_deadline && max_error < DBL_MAX;
+  }
+
+  time_simplify = rounds.stop();
+
+  cout << bluetty << "Time_simplify: " << (long)time_simplify << deftty << endl;
+  cout << lightredtty << "Failed pops: " << failed_pop << " - "
+       << failed_removed << " (removed) - " << failed_cost << " (cost)"
+       << deftty << endl;
+  cout << cyantty << "Left in queue: " << edge_queue.size() << deftty << endl;
+  cout << lightcyantty << "Removed: " << vertices_removed
+       << " - Max error: " << max_cost;
+  if (stopped_deadline)
+    cout << " (stopped at deadline)";
+  else if (stopped_error)
+    cout << " (stopped at error threshold)";
+  cout << deftty << endl;
+}
+
+#endif // SIMPDRIVER_H__
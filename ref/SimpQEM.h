@@ -1,34 +1,15 @@
 #ifndef SIMPQEM_H__
 #define SIMPQEM_H__
 
-#include "SimpELEN.h"
+#include "SimpDriver.h"
 
+// Quadric error metrics simplification (Garland, 97), collapsing edges to
+// their midpoints (SimpQEM) or to the points of least error (SimpQEMOptimal)
+typedef SimpDriver<QemMidpointCost> SimpQEM;
+typedef SimpDriver<QemOptimalCost> SimpQEMOptimal;
 
-class SimpQEM : public SimpELEN
-{
-public:
-
-
-  long int time_error = 0;
-  long int time_quadrics = 0;
-  long int time_other = 0;
-
-  //Methods
-  SimpQEM(Surface*, int);
-
-  //Operations
-  void initQuadrics(); //Initialize quadric matrix for every vertex
-  void initEdgeCosts();
-  void simplify(int, int);
-  void updateEdgeCosts(Point* v);
-  void updateEdgeCosts(Point* v, int c); //Update costs for v in cell c
-
-  double getCost(Edge* e);
-  double getCost(Point* p);
-  double getError(double v[4], double Q[4][4]);
-
-
-};
-
+// Instantiated once, in SimpQEM.cpp
+extern template class SimpDriver<QemMidpointCost>;
+extern template class SimpDriver<QemOptimalCost>;
 
 #endif //SIMPQEM_H__
@@ -5,30 +5,22 @@
 #include <iomanip>
 #include <iostream>
 
-// CGAL includes
-#include <CGAL/Simple_cartesian.h>
-#include <CGAL/intersections.h>
-
-typedef CGAL::Simple_cartesian<double> K;
-typedef K::Point_3 Point3;
-typedef K::Triangle_3 Triangle3;
-
 Surface::Surface(string inputFile) {
 
-  time_faces = 0;
-  time_edges = 0;
-  time_point = 0;
-  failed_collapses = 0;
-  timespec t0, t1, t;
-  clock_gettime(CLOCK_REALTIME, &t0);
+  ScopedPhase load("load");
   readSurface(inputFile);
-  clock_gettime(CLOCK_REALTIME, &t1);
-  t = diff(t0, t1);
-  cout << greentty << "Time_read_input_and_init_data: "
-       << t.tv_sec * 1000 + t.tv_nsec / 1000000 << deftty << endl;
+  cout << greentty << "Time_read_input_and_init_data: " << (long)load.stop()
+       << deftty << endl;
 }
 
-Surface::~Surface() {}
+Surface::~Surface() {
+  for (point_vec_it pit = m_points.begin(); pit != m_points.end(); ++pit)
+    delete *pit;
+  for (face_vec_it fit = m_faces.begin(); fit != m_faces.end(); ++fit)
+    delete *fit;
+  for (edge_vec_it eit = m_edges.begin(); eit != m_edges.end(); ++eit)
+    delete *eit;
+}
 
 void Surface::readSurface(string inputFile) {
 
@@ -307,8 +299,7 @@ void Surface::removeEdge(Edge *e) {
 
 bool Surface::collapse(Edge &e) {
 
-  timespec t0, t1, t;
-  clock_gettime(CLOCK_REALTIME, &t0);
+  TELEMETRY_START(tf);
   Point *p1 = e.p1;
   Point *p2 = e.p2;
 
@@ -319,7 +310,7 @@ bool Surface::collapse(Edge &e) {
       p2->faces.size() == 0) // Do not simplify boundary corners
   {
     // cerr << "*ERROR: EMPTY VERTEX.\n";
-    failed_collapses++;
+    TELEMETRY_COUNT("empty_vertex_collapses", 1);
     // cout << redtty << "failed.\n" << deftty;
     return false;
   }
@@ -366,12 +357,10 @@ bool Surface::collapse(Edge &e) {
   p2->y = e.placement->y;
   p2->z = e.placement->z;
 
-  clock_gettime(CLOCK_REALTIME, &t1);
-  t = diff(t0, t1);
-  time_faces += getNanoseconds(t);
+  TELEMETRY_STOP("collapse_faces_ns", tf);
 
   // TODO: more efficient to use std::remove_if
-  clock_gettime(CLOCK_REALTIME, &t0);
+  TELEMETRY_START(te);
   removeEdge(m_edges[e.id]);
 
   vector<Edge *> edges_to_remove;
@@ -436,16 +425,12 @@ bool Surface::collapse(Edge &e) {
   p2->to.insert(p2->to.end(), p1->to.begin(), p1->to.end());
   p2->from.insert(p2->from.end(), p1->from.begin(), p1->from.end());
 
-  clock_gettime(CLOCK_REALTIME, &t1);
-  t = diff(t0, t1);
-  time_edges += getNanoseconds(t);
+  TELEMETRY_STOP("collapse_edges_ns", te);
 
   // Can remove point p1
-  clock_gettime(CLOCK_REALTIME, &t0);
+  TELEMETRY_START(tp);
   removePoint(p1);
-  clock_gettime(CLOCK_REALTIME, &t1);
-  t = diff(t0, t1);
-  time_point += getNanoseconds(t);
+  TELEMETRY_STOP("collapse_point_ns", tp);
 
   return true;
 }
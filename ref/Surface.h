@@ -8,8 +8,9 @@
 //=====================
 // Local
 #include "Classes.h"
-#include "Vector3f.h"
+#include "../vector.h"
 #include "common.h"
+#include "../telemetry.h"
 //=====================
 
 #define METRIC_ELEN 1
@@ -35,11 +36,6 @@ public:
   Surface() {}
   ~Surface();
 
-  long int time_faces;
-  long int time_edges;
-  long int time_point;
-  int failed_collapses;
-
   // General
   void readSurface(string inputFile);
   void printVertices();
@@ -14,6 +14,16 @@ timespec diff(timespec start, timespec end)
         return temp;
 }
 
+long long int getMilliseconds(timespec t)
+{
+  return t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+long long int getNanoseconds(timespec t)
+{
+  return (1000000000 * t.tv_sec) + t.tv_nsec;
+}
+
 
 
 
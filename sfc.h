@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/*
+  Keys along space-filling curves through the unit cube. Points that are
+  close on a curve are close in space, so sorting by key gives an order with
+  good locality. Coordinates are quantized to 21 bits per axis, and a key
+  packs the three axes into 63 bits.
+
+  The Morton (Z-order) key interleaves the coordinate bits. The Hilbert key
+  also keeps consecutive cells adjacent, at the price of a few more
+  operations, using Skilling's transform ("Programming the Hilbert curve",
+  AIP Conf. Proc. 707, 2004).
+*/
+class SpaceFillingCurve {
+public:
+  enum Curve { NONE, MORTON, HILBERT };
+
+  static const int BITS = 21;
+
+private:
+  /* Bits 0..20 of <v> moved to bits 0, 3, 6, ... */
+  static uint64_t spread(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffULL;
+    v = (v | v << 16) & 0x1f0000ff0000ffULL;
+    v = (v | v << 8) & 0x100f00f00f00f00fULL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+  }
+
+  static uint32_t quantize(double t) {
+    const uint32_t max = (1u << BITS) - 1;
+    return t <= 0.0 ? 0 : t >= 1.0 ? max : std::min((uint32_t)(t * max), max);
+  }
+
+public:
+  static uint64_t morton(uint32_t x, uint32_t y, uint32_t z) {
+    return spread(x) | spread(y) << 1 | spread(z) << 2;
+  }
+
+  static uint64_t hilbert(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t X[3] = {x, y, z};
+    const uint32_t M = 1u << (BITS - 1);
+
+    // Inverse undo
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+      uint32_t P = Q - 1;
+      for (int i = 0; i < 3; i++) {
+        if (X[i] & Q) {
+          X[0] ^= P;
+        } else {
+          uint32_t t = (X[0] ^ X[i]) & P;
+          X[0] ^= t;
+          X[i] ^= t;
+        }
+      }
+    }
+
+    // Gray encode
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+      if (X[2] & Q) {
+        t ^= Q - 1;
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      X[i] ^= t;
+    }
+
+    // The transposed key has its most significant bit in X[0]
+    return morton(X[2], X[1], X[0]);
+  }
+
+  /* Key of the point at (x, y, z), given relative to the unit cube */
+  static uint64_t encode(Curve curve, double x, double y, double z) {
+    uint32_t qx = quantize(x), qy = quantize(y), qz = quantize(z);
+    return curve == HILBERT ? hilbert(qx, qy, qz) : morton(qx, qy, qz);
+  }
+
+  static bool parse(const char *name, Curve &curve) {
+    if (!strcmp(name, "morton")) {
+      curve = MORTON;
+    } else if (!strcmp(name, "hilbert")) {
+      curve = HILBERT;
+    } else if (!strcmp(name, "none")) {
+      curve = NONE;
+    } else {
+      return false;
+    }
+    return true;
+  }
+};
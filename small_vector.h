@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+/*
+  Vector of trivially copyable values that keeps its first <N> elements
+  inline and spills to the heap beyond that. Adjacency lists of a mesh hold a
+  handful of pointers each, so with <N> above the typical valence most of
+  them never allocate.
+
+  Order is not preserved by erase(), which moves the last element into the
+  hole; insert() and erase() treat the contents as a set and are linear,
+  which at these sizes is cheaper than any tree or hash. Spilled storage
+  comes from ::operator new, so the allocation profile (alloc.h) sees it.
+*/
+template <typename T, int N> class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SmallVector moves its elements with memcpy");
+
+  T *items;
+  int count;
+  int capacity;
+  T local[N];
+
+  void grow(int minimum) {
+    int capacity = std::max(2 * this->capacity, minimum);
+    T *items = (T *)::operator new(capacity * sizeof(T));
+    memcpy(items, this->items, this->count * sizeof(T));
+    if (this->items != this->local) {
+      ::operator delete(this->items);
+    }
+    this->items = items;
+    this->capacity = capacity;
+  }
+
+public:
+  SmallVector() : items(local), count(0), capacity(N) {}
+
+  SmallVector(const SmallVector &v) : SmallVector() { *this = v; }
+
+  ~SmallVector() {
+    if (this->items != this->local) {
+      ::operator delete(this->items);
+    }
+  }
+
+  SmallVector &operator=(const SmallVector &v) {
+    if (this != &v) {
+      this->count = 0;
+      if (v.count > this->capacity) {
+        this->grow(v.count);
+      }
+      memcpy(this->items, v.items, v.count * sizeof(T));
+      this->count = v.count;
+    }
+    return *this;
+  }
+
+  int size() const { return this->count; }
+  bool empty() const { return this->count == 0; }
+
+  T *begin() { return this->items; }
+  T *end() { return this->items + this->count; }
+  const T *begin() const { return this->items; }
+  const T *end() const { return this->items + this->count; }
+
+  T &operator[](int i) { return this->items[i]; }
+  const T &operator[](int i) const { return this->items[i]; }
+
+  void push_back(const T &value) {
+    if (this->count == this->capacity) {
+      this->grow(this->count + 1);
+    }
+    this->items[this->count++] = value;
+  }
+
+  /* Keeps the storage, so a cleared list refills without allocating */
+  void clear() { this->count = 0; }
+
+  bool contains(const T &value) const {
+    for (int i = 0; i < this->count; i++) {
+      if (this->items[i] == value) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /* Append <value> unless already present; returns whether it was added */
+  bool insert(const T &value) {
+    if (this->contains(value)) {
+      return false;
+    }
+    this->push_back(value);
+    return true;
+  }
+
+  /* Remove <value> if present, moving the last element into its place */
+  bool erase(const T &value) {
+    for (int i = 0; i < this->count; i++) {
+      if (this->items[i] == value) {
+        this->items[i] = this->items[--this->count];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /* Heap bytes held beyond the object itself */
+  size_t getHeapBytes() const {
+    return this->items == this->local ? 0 : this->capacity * sizeof(T);
+  }
+};
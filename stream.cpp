@@ -0,0 +1,592 @@
+#include "stream.h"
+#include "qem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/******************************************************************************/
+/* Input */
+
+void StreamingSimplifier::readHeader(const char *inputFile) {
+  int rv;
+  long long counts[3];
+  char buffer[256];
+
+  this->input = fopen(inputFile, "r");
+  if (!this->input) {
+    std::cerr << std::endl
+              << "Error:  Unable to read "
+                 "input file. Please check "
+                 "the file "
+                 "path and permissions."
+              << std::endl;
+    exit(11);
+  }
+
+  rv = fscanf(this->input, "%s\n", buffer);
+  if (!rv || strncmp("OFF", buffer, 3)) {
+    std::cerr << std::endl
+              << "Error:  Invalid input file "
+                 "format. Only OFF (Object "
+                 "File "
+                 "Format) (.off) files are "
+                 "accepted."
+              << std::endl;
+    exit(12);
+  }
+
+  rv = fscanf(this->input, "%lld %lld %lld\n", &counts[0], &counts[1],
+              &counts[2]);
+  if (rv != 3 || counts[0] < 0 || counts[1] < 0) {
+    std::cerr << std::endl
+              << "Error:  Invalid input file "
+                 "format. Only OFF (Object "
+                 "File "
+                 "Format) (.off) files are "
+                 "accepted."
+              << std::endl;
+    exit(13);
+  }
+  if (counts[0] > MAX_INDEX || counts[1] > MAX_INDEX) {
+    std::cerr << std::endl
+              << "Error:  The mesh has more vertices or faces than "
+              << MAX_INDEX << ", the most " << 8 * sizeof(Index)
+              << "-bit ids can hold. Rebuild with make INDEX64=1."
+              << std::endl;
+    exit(18);
+  }
+
+  this->noOfVertices = counts[0];
+  this->noOfFaces = counts[1];
+}
+
+void StreamingSimplifier::spillVertices() {
+  std::cout << "Spilling vertices... ";
+
+  this->positions = tmpfile();
+  if (!this->positions) {
+    std::cout << "Failed!" << std::endl;
+    std::cerr << std::endl
+              << "Error:  Unable to create temporary file." << std::endl;
+    exit(17);
+  }
+
+  double p[3];
+  for (Index i = 0; i < this->noOfVertices; i++) {
+    if (fscanf(this->input, "%lf %lf %lf\n", &p[0], &p[1], &p[2]) != 3) {
+      std::cout << "Failed!" << std::endl;
+      std::cerr << std::endl
+                << "Error:  Invalid input "
+                   "file format. Only OFF "
+                   "(Object File "
+                   "Format) (.off) files are "
+                   "accepted."
+                << std::endl;
+      exit(14);
+    }
+    fwrite(p, sizeof(double), 3, this->positions);
+  }
+  fflush(this->positions);
+
+  std::cout << "Done" << std::endl;
+}
+
+void StreamingSimplifier::countFaces() {
+  std::cout << "Counting face references... ";
+
+  long faceSection = ftell(this->input);
+  this->pendingFaces.assign(this->noOfVertices, 0);
+
+  std::vector<long long> polygon;
+  Index noOfPolygons = 0;
+  for (Index i = 0; i < this->noOfFaces; i++) {
+    if (!Mesh::readPolygon(this->input, polygon)) {
+      std::cout << "Failed!" << std::endl;
+      std::cerr << std::endl
+                << "Error:  Invalid input "
+                   "file format. Only OFF "
+                   "(Object File "
+                   "Format) (.off) files are "
+                   "accepted."
+                << std::endl;
+      exit(15);
+    }
+    for (long long v : polygon) {
+      if (v < 0 || v >= this->noOfVertices) {
+        std::cout << "Failed!" << std::endl;
+        std::cerr << std::endl
+                  << "Error:  Face " << i << " references vertex " << v
+                  << " which does not exist." << std::endl;
+        exit(15);
+      }
+    }
+
+    // Polygons are fanned around their first vertex, as in Mesh::readFaces
+    noOfPolygons += polygon.size() > 3;
+    for (int j = 1; j + 1 < (int)polygon.size(); j++) {
+      this->pendingFaces[polygon[0]]++;
+      this->pendingFaces[polygon[j]]++;
+      this->pendingFaces[polygon[j + 1]]++;
+    }
+  }
+
+  // Vertices no face references are dropped from the output, which counts
+  // towards the target like a collapse
+  for (Index i = 0; i < this->noOfVertices; i++) {
+    if (!this->pendingFaces[i]) {
+      this->noOfFinalizedVertices++;
+      this->noOfRemovedVertices++;
+    }
+  }
+
+  fseek(this->input, faceSection, SEEK_SET);
+
+  std::cout << "Done";
+  if (noOfPolygons) {
+    std::cout << " [" << noOfPolygons << " polygon(s) triangulated]";
+  }
+  std::cout << std::endl;
+}
+
+/******************************************************************************/
+/* Window */
+
+Index StreamingSimplifier::loadVertex(Index id) {
+  auto it = this->window.find(id);
+  if (it != this->window.end()) {
+    return it->second;
+  }
+
+  Index slot;
+  if (this->freeVertices.size()) {
+    slot = this->freeVertices.back();
+    this->freeVertices.pop_back();
+  } else {
+    slot = this->vertices.size();
+    this->vertices.push_back(WindowVertex());
+  }
+
+  double p[3];
+  if (pread(fileno(this->positions), p, sizeof(p), (off_t)id * sizeof(p)) !=
+      sizeof(p)) {
+    std::cerr << std::endl
+              << "Error:  Unable to read temporary file." << std::endl;
+    exit(17);
+  }
+
+  WindowVertex &v = this->vertices[slot];
+  v.id = id;
+  v.outputId = -1;
+  v.stamp = 0;
+  v.removed = false;
+  v.x = p[0];
+  v.y = p[1];
+  v.z = p[2];
+  memset(v.Q, 0, sizeof(Quadric));
+  v.faces.clear();
+
+  this->window[id] = slot;
+  this->peakWindowVertices =
+      std::max(this->peakWindowVertices, (Index)this->window.size());
+
+  return slot;
+}
+
+void StreamingSimplifier::addFace(Index a, Index b, Index c) {
+  Index ids[3] = {a, b, c};
+
+  if (a != b && b != c && a != c) {
+    Index slots[3];
+    for (int i = 0; i < 3; i++) {
+      slots[i] = this->loadVertex(ids[i]);
+    }
+
+    Index f;
+    if (this->freeFaces.size()) {
+      f = this->freeFaces.back();
+      this->freeFaces.pop_back();
+    } else {
+      f = this->faces.size();
+      this->faces.push_back(WindowFace());
+    }
+
+    double p[3][3];
+    for (int i = 0; i < 3; i++) {
+      WindowVertex &v = this->vertices[slots[i]];
+      p[i][0] = v.x;
+      p[i][1] = v.y;
+      p[i][2] = v.z;
+      v.faces.push_back(f);
+      this->faces[f].v[i] = slots[i];
+    }
+    this->faces[f].removed = false;
+
+    Quadric Kp;
+    QuadricErrorMetrics::calculatePlaneQuadric(p[0], p[1], p[2], Kp);
+    for (int i = 0; i < 3; i++) {
+      QuadricErrorMetrics::sumQuadrics(this->vertices[slots[i]].Q, Kp);
+    }
+
+    this->noOfWindowFaces++;
+    this->peakWindowFaces =
+        std::max(this->peakWindowFaces, this->noOfWindowFaces);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (--this->pendingFaces[ids[i]] == 0) {
+      this->noOfFinalizedVertices++;
+
+      // A degenerate face may have been the only reference to this vertex
+      auto it = this->window.find(ids[i]);
+      if (it != this->window.end() &&
+          this->vertices[it->second].faces.empty()) {
+        this->releaseVertex(it->second);
+      }
+    }
+  }
+}
+
+bool StreamingSimplifier::isFinalized(const WindowVertex &v) const {
+  return this->pendingFaces[v.id] == 0;
+}
+
+bool StreamingSimplifier::isCollapsible(const WindowVertex &v) const {
+  return v.id >= 0 && !v.removed && v.outputId < 0 && this->isFinalized(v);
+}
+
+void StreamingSimplifier::releaseVertex(Index slot) {
+  WindowVertex &v = this->vertices[slot];
+  this->window.erase(v.id);
+  v.id = -1;
+  v.removed = true;
+  v.faces.clear();
+  this->freeVertices.push_back(slot);
+}
+
+/******************************************************************************/
+/* Simplification */
+
+/* Queue a collapse for each edge from <slot> to a collapsible neighbour */
+void StreamingSimplifier::pushCollapses(std::priority_queue<Collapse> &queue,
+                                        Index slot) {
+  const WindowVertex &v1 = this->vertices[slot];
+  Placement batch;
+  Collapse collapses[Placement::BATCH_SIZE];
+  Quadric Q;
+
+  auto flush = [&]() {
+    batch.solve(this->placementPolicy);
+    for (int lane = 0; lane < batch.getSize(); lane++) {
+      Collapse &c = collapses[lane];
+      c.cost = batch.getCost(lane);
+      c.x = batch.getX(lane);
+      c.y = batch.getY(lane);
+      c.z = batch.getZ(lane);
+      queue.push(c);
+    }
+    batch.clear();
+  };
+
+  for (Index f : v1.faces) {
+    for (int i = 0; i < 3; i++) {
+      Index other = this->faces[f].v[i];
+      if (other == slot || !this->isCollapsible(this->vertices[other])) {
+        continue;
+      }
+      const WindowVertex &v2 = this->vertices[other];
+
+      // Cost is given by v'Qv, where v is the placement of the summed
+      // quadric, as in QuadricErrorMetrics
+      memcpy(Q, v1.Q, sizeof(Quadric));
+      QuadricErrorMetrics::sumQuadrics(Q, v2.Q);
+      Scalar p1[3] = {v1.x, v1.y, v1.z};
+      Scalar p2[3] = {v2.x, v2.y, v2.z};
+
+      Collapse &c = collapses[batch.add(Q, p1, p2)];
+      c.v1 = slot;
+      c.v2 = other;
+      c.stamp1 = v1.stamp;
+      c.stamp2 = v2.stamp;
+      if (batch.isFull()) {
+        flush();
+      }
+    }
+  }
+  flush();
+}
+
+/* Merge the vertex in slot <c>.v1 into the vertex in slot <c>.v2 */
+void StreamingSimplifier::collapse(const Collapse &c) {
+  Index s1 = c.v1, s2 = c.v2;
+  WindowVertex &v1 = this->vertices[s1];
+  WindowVertex &v2 = this->vertices[s2];
+
+  v2.x = c.x;
+  v2.y = c.y;
+  v2.z = c.z;
+  QuadricErrorMetrics::sumQuadrics(v2.Q, v1.Q);
+  v2.stamp++;
+
+  for (Index f : v1.faces) {
+    WindowFace &face = this->faces[f];
+
+    if (face.v[0] == s2 || face.v[1] == s2 || face.v[2] == s2) {
+      // Face shared by v1 and v2 degenerates, remove it
+      for (int i = 0; i < 3; i++) {
+        if (face.v[i] != s1) {
+          std::vector<Index> &vf = this->vertices[face.v[i]].faces;
+          auto it = std::find(vf.begin(), vf.end(), f);
+          *it = vf.back();
+          vf.pop_back();
+        }
+      }
+      face.removed = true;
+      this->freeFaces.push_back(f);
+      this->noOfWindowFaces--;
+    } else {
+      for (int i = 0; i < 3; i++) {
+        if (face.v[i] == s1) {
+          face.v[i] = s2;
+        }
+      }
+      v2.faces.push_back(f);
+    }
+  }
+
+  this->releaseVertex(s1);
+  this->noOfRemovedVertices++;
+}
+
+/* Greedily collapse the cheapest edges between finalized vertices */
+void StreamingSimplifier::simplifyWindow(Index quota) {
+  if (quota <= 0) {
+    return;
+  }
+
+  std::priority_queue<Collapse> queue;
+  for (Index slot = 0; slot < (Index)this->vertices.size(); slot++) {
+    if (this->isCollapsible(this->vertices[slot])) {
+      this->pushCollapses(queue, slot);
+    }
+  }
+
+  while (quota > 0 && !queue.empty()) {
+    Collapse c = queue.top();
+    queue.pop();
+
+    const WindowVertex &v1 = this->vertices[c.v1];
+    const WindowVertex &v2 = this->vertices[c.v2];
+    if (!this->isCollapsible(v1) || !this->isCollapsible(v2) ||
+        v1.stamp != c.stamp1 || v2.stamp != c.stamp2) {
+      continue;
+    }
+
+    this->collapse(c);
+    this->pushCollapses(queue, c.v2);
+    quota--;
+  }
+}
+
+/******************************************************************************/
+/* Output */
+
+Index StreamingSimplifier::writeVertex(Index slot) {
+  WindowVertex &v = this->vertices[slot];
+  if (v.outputId < 0) {
+    v.outputId = this->noOfOutputVertices++;
+    fprintf(this->outputVertices, "%lf %lf %lf\n", v.x, v.y, v.z);
+
+    QuadricScalar p[4] = {v.x, v.y, v.z, 1};
+    this->error += QuadricErrorMetrics::calculateError(p, v.Q);
+  }
+  return v.outputId;
+}
+
+/*
+  Write out every face whose vertices are finalized and only have finalized
+  neighbours. Written vertices are frozen and no longer collapsed.
+*/
+void StreamingSimplifier::retireFaces() {
+  std::vector<char> closed(this->vertices.size(), 0);
+  for (Index slot = 0; slot < (Index)this->vertices.size(); slot++) {
+    const WindowVertex &v = this->vertices[slot];
+    if (v.id < 0 || !this->isFinalized(v)) {
+      continue;
+    }
+
+    closed[slot] = 1;
+    for (Index f : v.faces) {
+      for (int i = 0; i < 3; i++) {
+        if (!this->isFinalized(this->vertices[this->faces[f].v[i]])) {
+          closed[slot] = 0;
+        }
+      }
+    }
+  }
+
+  for (Index f = 0; f < (Index)this->faces.size(); f++) {
+    WindowFace &face = this->faces[f];
+    if (face.removed || !closed[face.v[0]] || !closed[face.v[1]] ||
+        !closed[face.v[2]]) {
+      continue;
+    }
+
+    Index ids[3];
+    for (int i = 0; i < 3; i++) {
+      ids[i] = this->writeVertex(face.v[i]);
+    }
+    fprintf(this->outputFaces, "3 %lld %lld %lld\n", (long long)ids[0],
+            (long long)ids[1], (long long)ids[2]);
+    this->noOfOutputFaces++;
+
+    for (int i = 0; i < 3; i++) {
+      std::vector<Index> &vf = this->vertices[face.v[i]].faces;
+      auto it = std::find(vf.begin(), vf.end(), f);
+      *it = vf.back();
+      vf.pop_back();
+      if (vf.empty()) {
+        this->releaseVertex(face.v[i]);
+      }
+    }
+    face.removed = true;
+    this->freeFaces.push_back(f);
+    this->noOfWindowFaces--;
+  }
+}
+
+void StreamingSimplifier::write(const char *outputFile) {
+  std::cout << "Saving mesh in OFF format... ";
+
+  FILE *file = fopen(outputFile, "w");
+  if (!file) {
+    std::cerr << std::endl
+              << "Error:  Unable to "
+                 "create output file."
+              << std::endl;
+    exit(16);
+  }
+
+  fprintf(file, "OFF\n");
+  fprintf(file, "%lld %lld %d\n", (long long)this->noOfOutputVertices,
+          (long long)this->noOfOutputFaces, 0);
+
+  char buffer[1 << 16];
+  size_t n;
+  FILE *parts[2] = {this->outputVertices, this->outputFaces};
+  for (FILE *part : parts) {
+    rewind(part);
+    while ((n = fread(buffer, 1, sizeof(buffer), part)) > 0) {
+      fwrite(buffer, 1, n, file);
+    }
+  }
+
+  fclose(file);
+
+  std::cout << "Done" << std::endl;
+}
+
+/******************************************************************************/
+
+StreamingSimplifier::StreamingSimplifier(const char *inputFile,
+                                         Index windowSize,
+                                         Placement::Policy placementPolicy) {
+  this->windowSize = std::max(windowSize, (Index)1);
+  this->placementPolicy = placementPolicy;
+  this->noOfWindowFaces = 0;
+  this->noOfOutputVertices = 0;
+  this->noOfOutputFaces = 0;
+  this->noOfFinalizedVertices = 0;
+  this->noOfRemovedVertices = 0;
+  this->peakWindowFaces = 0;
+  this->peakWindowVertices = 0;
+  this->error = 0.0;
+
+  std::cout << std::endl;
+  this->readHeader(inputFile);
+  this->spillVertices();
+  this->countFaces();
+
+  std::cout << std::endl;
+  std::cout << "Number Of Vertex(s) : " << this->noOfVertices << std::endl;
+  std::cout << "Number Of Face(s)   : " << this->noOfFaces << std::endl;
+}
+
+StreamingSimplifier::~StreamingSimplifier() {
+  fclose(this->input);
+  fclose(this->positions);
+}
+
+void StreamingSimplifier::simplify(float goal, const char *outputFile) {
+  Index target = goal * this->noOfVertices;
+
+  this->outputVertices = tmpfile();
+  this->outputFaces = tmpfile();
+  if (!this->outputVertices || !this->outputFaces) {
+    std::cerr << std::endl
+              << "Error:  Unable to create temporary file." << std::endl;
+    exit(17);
+  }
+
+  std::cout << std::endl;
+  std::cout << "Simplifying [target = " << this->noOfVertices - target
+            << " vertex(s), window = " << this->windowSize << " face(s)]... ";
+
+  std::vector<long long> polygon;
+  Index nextFlush = this->windowSize;
+  for (Index i = 0; i < this->noOfFaces; i++) {
+    if (!Mesh::readPolygon(this->input, polygon)) {
+      std::cout << "Failed!" << std::endl;
+      std::cerr << std::endl
+                << "Error:  Input file changed while streaming." << std::endl;
+      exit(15);
+    }
+    for (int j = 1; j + 1 < (int)polygon.size(); j++) {
+      this->addFace(polygon[0], polygon[j], polygon[j + 1]);
+    }
+
+    if (this->noOfWindowFaces >= nextFlush) {
+      // Keep the removed share of the finalized vertices at <goal>
+      this->simplifyWindow(goal * this->noOfFinalizedVertices -
+                           this->noOfRemovedVertices);
+      this->retireFaces();
+
+      // A front wider than the window cannot be retired yet; grow past it
+      // instead of flushing on every face
+      nextFlush = std::max(this->windowSize,
+                           this->noOfWindowFaces +
+                               std::max(this->windowSize / 4, (Index)1));
+    }
+  }
+
+  // Every vertex is finalized now
+  this->simplifyWindow(target - this->noOfRemovedVertices);
+  this->retireFaces();
+
+  std::cout << "Done [" << this->noOfRemovedVertices << " vertex(s) removed]"
+            << std::endl;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::cout << std::endl;
+  std::cout << "Peak Window Face(s)   : " << this->peakWindowFaces << std::endl;
+  std::cout << "Peak Window Vertex(s) : " << this->peakWindowVertices
+            << std::endl;
+  std::cout << "Peak Resident Memory  : " << usage.ru_maxrss / 1024 << " MB"
+            << std::endl;
+  std::cout << "Error (sum vQv)       : " << this->error << std::endl;
+
+  std::cout << std::endl;
+  this->write(outputFile);
+
+  fclose(this->outputVertices);
+  fclose(this->outputFaces);
+}
+
+Index StreamingSimplifier::getNoOfOutputVertices() const {
+  return this->noOfOutputVertices;
+}
+
+double StreamingSimplifier::getError() const { return this->error; }
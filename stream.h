@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "index.h"
+#include "placement.h"
+#include "precision.h"
+
+/*
+  Out-of-core QEM edge collapse for OFF files that are too large for Mesh.
+
+  Faces are streamed from the input, polygons fanned into triangles as
+  Mesh::readFaces does, and only an active window of triangles and the
+  vertices they reference is kept in memory. A vertex is finalized
+  once every face referencing it has been read; an edge is collapsed only when
+  both of its end points are finalized, so its neighbourhood is fully loaded.
+  Faces whose vertices and their neighbours are all finalized are retired to
+  the output and dropped from the window.
+
+  Input vertex positions are spilled to a temporary file and read back on
+  first reference. Besides the window, the only per-vertex state is a count of
+  the faces still to be read (one Index per input vertex), since OFF carries
+  no finalization tags.
+*/
+class StreamingSimplifier {
+  struct WindowVertex {
+    Index id;       // index in the input file, -1 for a free slot
+    Index outputId; // index in the output file, -1 until written
+    Index stamp;    // bumped whenever another vertex is merged into this one
+    bool removed;
+    Scalar x, y, z;
+    Quadric Q;
+    std::vector<Index> faces; // window faces referencing this vertex
+  };
+
+  struct WindowFace {
+    Index v[3]; // window vertex slots
+    bool removed;
+  };
+
+  struct Collapse {
+    double cost;
+    Index v1, v2; // v1 is merged into v2
+    Index stamp1, stamp2;
+    Scalar x, y, z; // where v2 goes
+
+    bool operator<(const Collapse &c) const { return cost > c.cost; }
+  };
+
+  Index noOfVertices;
+  Index noOfFaces;
+  Index windowSize;
+  Placement::Policy placementPolicy;
+
+  FILE *input;
+  FILE *positions;
+  std::vector<Index> pendingFaces;
+
+  std::vector<WindowVertex> vertices;
+  std::vector<WindowFace> faces;
+  std::vector<Index> freeVertices;
+  std::vector<Index> freeFaces;
+  std::unordered_map<Index, Index> window;
+  Index noOfWindowFaces;
+
+  FILE *outputVertices;
+  FILE *outputFaces;
+  Index noOfOutputVertices;
+  Index noOfOutputFaces;
+
+  Index noOfFinalizedVertices;
+  Index noOfRemovedVertices;
+  Index peakWindowFaces;
+  Index peakWindowVertices;
+  double error;
+
+  void readHeader(const char *);
+  void spillVertices();
+  void countFaces();
+
+  Index loadVertex(Index);
+  void addFace(Index, Index, Index);
+  bool isFinalized(const WindowVertex &) const;
+  bool isCollapsible(const WindowVertex &) const;
+
+  void pushCollapses(std::priority_queue<Collapse> &, Index);
+  void collapse(const Collapse &);
+  void simplifyWindow(Index);
+  Index writeVertex(Index);
+  void retireFaces();
+  void releaseVertex(Index);
+
+  void write(const char *);
+
+public:
+  StreamingSimplifier() = delete;
+  StreamingSimplifier(const char *inputFile, Index windowSize,
+                      Placement::Policy placementPolicy = Placement::OPTIMAL);
+  ~StreamingSimplifier();
+
+  void simplify(float goal, const char *outputFile);
+
+  Index getNoOfOutputVertices() const;
+  double getError() const;
+};
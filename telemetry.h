@@ -0,0 +1,366 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc.h"
+#include "perf.h"
+#include "tracing.h"
+
+/*
+  Run telemetry shared by both engines.
+
+  Phases are timed from serial code with ScopedPhase on the monotonic clock.
+  They cost two clock reads each, so they are always recorded and feed the
+  engine reports, and show up as events of the calling thread when tracing is
+  enabled (tracing.h). With PerfCounters enabled (perf.h) every phase also
+  gets the process-wide hardware counter deltas over its span, and the report
+  derives instructions per cycle from them. Builds with the allocation
+  profile (alloc.h) add the heap allocations, bytes and peak live bytes of
+  every phase the same way.
+
+  Counters inside the parallel loops go through the TELEMETRY_* macros, which
+  add to a slot owned by the calling thread without any synchronization. The
+  slots of every thread are merged into the innermost phase when it ends,
+  which is after the parallel regions it encloses have joined. The counters
+  only exist when built with -DTELEMETRY (make TELEMETRY=1); otherwise the
+  macros expand to nothing.
+
+  Telemetry::get().save() writes the phases, their counters and any values
+  set with setValue() as one JSON report per run.
+*/
+class Telemetry {
+public:
+  static const int MAX_COUNTERS = 64;
+
+  typedef std::vector<std::pair<std::string, long long>> Counters;
+
+  struct Phase {
+    std::string name;
+    int depth;       // number of enclosing phases
+    double start;    // milliseconds since the last reset
+    double duration; // milliseconds
+    Counters counters;
+  };
+
+private:
+  std::mutex mutex;
+  long long origin;
+  int depth;
+  std::vector<Phase> phases;
+  std::vector<std::string> counterNames;
+  std::vector<std::unique_ptr<long long[]>> slots; // one array per thread
+  std::vector<std::pair<std::string, double>> values;
+
+  Telemetry() : origin(now()), depth(0) {}
+  Telemetry(const Telemetry &) = delete;
+
+  long long *allocateSlots() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->slots.emplace_back(new long long[MAX_COUNTERS]());
+    return this->slots.back().get();
+  }
+
+  friend class ScopedPhase;
+
+  int beginPhase(const char *name) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Phase phase;
+    phase.name = name;
+    phase.depth = this->depth++;
+    phase.start = (now() - this->origin) / 1e6;
+    phase.duration = 0.0;
+    this->phases.push_back(phase);
+    return this->phases.size() - 1;
+  }
+
+  /* <measured>: counts over the phase span, ahead of the slot counters */
+  void endPhase(int index, double duration, const Counters &measured) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->depth--;
+    if (index >= (int)this->phases.size()) {
+      return; // reset while the phase was open
+    }
+
+    Phase &phase = this->phases[index];
+    phase.duration = duration;
+    phase.counters = measured;
+    for (int id = 0; id < (int)this->counterNames.size(); id++) {
+      long long total = 0;
+      for (auto &threadSlots : this->slots) {
+        total += threadSlots[id];
+        threadSlots[id] = 0;
+      }
+      if (total) {
+        phase.counters.push_back(
+            std::make_pair(this->counterNames[id], total));
+      }
+    }
+  }
+
+public:
+  /* Monotonic time in nanoseconds */
+  static long long now() { return Tracer::now(); }
+
+  static Telemetry &get() {
+    static Telemetry telemetry;
+    return telemetry;
+  }
+
+  /* Counter slots of the calling thread, indexed by counter id */
+  static long long *local() {
+    thread_local long long *threadSlots = get().allocateSlots();
+    return threadSlots;
+  }
+
+  static constexpr bool isEnabled() {
+#ifdef TELEMETRY
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /* Id of the counter <name>, registered on first use */
+  int counter(const char *name) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (int id = 0; id < (int)this->counterNames.size(); id++) {
+      if (this->counterNames[id] == name) {
+        return id;
+      }
+    }
+    assert(this->counterNames.size() < MAX_COUNTERS);
+    this->counterNames.push_back(name);
+    return this->counterNames.size() - 1;
+  }
+
+  /* Run-level result reported next to the phases, e.g. the output size */
+  void setValue(const char *name, double value) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto &v : this->values) {
+      if (v.first == name) {
+        v.second = value;
+        return;
+      }
+    }
+    this->values.push_back(std::make_pair(name, value));
+  }
+
+  /* Forget everything recorded so far; phases still open are dropped */
+  void reset() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->origin = now();
+    this->phases.clear();
+    this->values.clear();
+    for (auto &threadSlots : this->slots) {
+      std::fill(threadSlots.get(), threadSlots.get() + MAX_COUNTERS, 0);
+    }
+  }
+
+  const std::vector<Phase> &getPhases() const { return this->phases; }
+
+  bool save(const char *jsonFile) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    FILE *file = fopen(jsonFile, "w");
+    if (!file) {
+      return false;
+    }
+
+    fprintf(file, "{\n  \"counters_enabled\": %s,\n",
+            isEnabled() ? "true" : "false");
+    fprintf(file, "  \"values\": {");
+    for (int i = 0; i < (int)this->values.size(); i++) {
+      fprintf(file, "%s\"%s\": %.17g", i ? ", " : "",
+              this->values[i].first.c_str(), this->values[i].second);
+    }
+    fprintf(file, "},\n  \"phases\": [\n");
+    for (int i = 0; i < (int)this->phases.size(); i++) {
+      const Phase &p = this->phases[i];
+      fprintf(file,
+              "    {\"name\": \"%s\", \"depth\": %d, \"start_ms\": %f, "
+              "\"duration_ms\": %f, \"counters\": {",
+              p.name.c_str(), p.depth, p.start, p.duration);
+      long long cycles = 0;
+      long long instructions = 0;
+      for (int j = 0; j < (int)p.counters.size(); j++) {
+        fprintf(file, "%s\"%s\": %lld", j ? ", " : "",
+                p.counters[j].first.c_str(), p.counters[j].second);
+        if (p.counters[j].first == "cycles") {
+          cycles = p.counters[j].second;
+        } else if (p.counters[j].first == "instructions") {
+          instructions = p.counters[j].second;
+        }
+      }
+      if (cycles > 0 && instructions > 0) {
+        fprintf(file, ", \"ipc\": %f", (double)instructions / cycles);
+      }
+      fprintf(file, "}}%s\n", i + 1 < (int)this->phases.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+  }
+};
+
+/* Power-of-two histogram of durations in nanoseconds */
+struct Histogram {
+  static const int NO_OF_BUCKETS = 40;
+  long long counts[NO_OF_BUCKETS] = {}; // bucket b holds [2^b, 2^(b+1)) ns
+
+  void add(long long ns) {
+    int bucket = ns > 1 ? 63 - __builtin_clzll(ns) : 0;
+    this->counts[std::min(bucket, NO_OF_BUCKETS - 1)]++;
+  }
+
+  void merge(const Histogram &histogram) {
+    for (int b = 0; b < NO_OF_BUCKETS; b++) {
+      this->counts[b] += histogram.counts[b];
+    }
+  }
+
+  long long getCount() const {
+    long long count = 0;
+    for (int b = 0; b < NO_OF_BUCKETS; b++) {
+      count += this->counts[b];
+    }
+    return count;
+  }
+
+  /* Upper bound, in ns, of the bucket holding the <p>th percentile */
+  long long percentile(double p) const {
+    long long rank = p / 100.0 * this->getCount();
+    long long seen = 0;
+    for (int b = 0; b < NO_OF_BUCKETS; b++) {
+      seen += this->counts[b];
+      if (seen > rank) {
+        return 2LL << b;
+      }
+    }
+    return 0;
+  }
+};
+
+/*
+  Times the enclosing scope as phase <name>. Phases nest, and must be opened
+  and closed from serial code.
+*/
+class ScopedPhase {
+  const char *name;
+  int index;
+  long long t0;
+  double duration;
+  bool running;
+  std::vector<long long> perfCounts; // totals at the start
+  AllocationProfile::Totals allocations;
+  long long outerPeak;
+
+public:
+  ScopedPhase(const char *name)
+      : name(name), index(Telemetry::get().beginPhase(name)),
+        t0(Telemetry::now()), duration(0.0), running(true) {
+    if (PerfCounters::get().isEnabled()) {
+      this->perfCounts = PerfCounters::get().read();
+    }
+    if (AllocationProfile::isEnabled()) {
+      this->allocations = AllocationProfile::read();
+      this->outerPeak = AllocationProfile::beginPeak();
+    }
+  }
+  ScopedPhase(const ScopedPhase &) = delete;
+  ~ScopedPhase() { this->stop(); }
+
+  /* End the phase early; returns its duration in milliseconds */
+  double stop() {
+    if (this->running) {
+      long long t1 = Telemetry::now();
+      this->duration = (t1 - this->t0) / 1e6;
+      this->running = false;
+      if (Tracer::get().isEnabled()) {
+        Tracer::get().record(this->name, this->t0, t1);
+      }
+      // Allocations first, before reporting allocates anything itself
+      long long peak = 0;
+      AllocationProfile::Totals allocations = {};
+      if (AllocationProfile::isEnabled()) {
+        peak = AllocationProfile::endPeak(this->outerPeak);
+        allocations = AllocationProfile::read();
+      }
+      Telemetry::Counters measured;
+      if (!this->perfCounts.empty()) {
+        std::vector<std::string> names = PerfCounters::get().getNames();
+        std::vector<long long> totals = PerfCounters::get().read();
+        for (int e = 0; e < (int)totals.size(); e++) {
+          measured.push_back(
+              std::make_pair(names[e], totals[e] - this->perfCounts[e]));
+        }
+      }
+      if (AllocationProfile::isEnabled()) {
+        measured.push_back(std::make_pair(
+            "allocations",
+            allocations.allocations - this->allocations.allocations));
+        measured.push_back(std::make_pair(
+            "allocated_bytes", allocations.bytes - this->allocations.bytes));
+        measured.push_back(std::make_pair("peak_live_bytes", peak));
+      }
+      Telemetry::get().endPhase(this->index, this->duration, measured);
+    }
+    return this->duration;
+  }
+};
+
+#ifdef TELEMETRY
+
+/* Adds nanoseconds from construction to destruction to counter <id> */
+class ScopedTimer {
+  int id;
+  long long t0;
+
+public:
+  ScopedTimer(int id) : id(id), t0(Telemetry::now()) {}
+  ~ScopedTimer() { Telemetry::local()[this->id] += Telemetry::now() - t0; }
+};
+
+#define TELEMETRY_CONCAT_(a, b) a##b
+#define TELEMETRY_CONCAT(a, b) TELEMETRY_CONCAT_(a, b)
+#define TELEMETRY_ID(name)                                                     \
+  ([]() {                                                                      \
+    static const int id = Telemetry::get().counter(name);                      \
+    return id;                                                                 \
+  }())
+
+/* Add <n> to counter <name> */
+#define TELEMETRY_COUNT(name, n)                                               \
+  do {                                                                         \
+    Telemetry::local()[TELEMETRY_ID(name)] += (n);                             \
+  } while (0)
+
+/* Add the time spent in the rest of the scope, in ns, to counter <name> */
+#define TELEMETRY_TIMER(name)                                                  \
+  ScopedTimer TELEMETRY_CONCAT(telemetryTimer, __LINE__)(TELEMETRY_ID(name))
+
+/* Unscoped pair: TELEMETRY_STOP adds the ns since TELEMETRY_START(t) */
+#define TELEMETRY_START(t) long long t = Telemetry::now()
+#define TELEMETRY_STOP(name, t) TELEMETRY_COUNT(name, Telemetry::now() - (t))
+
+#else
+
+#define TELEMETRY_COUNT(name, n)                                               \
+  do {                                                                         \
+  } while (0)
+#define TELEMETRY_TIMER(name)                                                  \
+  do {                                                                         \
+  } while (0)
+#define TELEMETRY_START(t)                                                     \
+  do {                                                                         \
+  } while (0)
+#define TELEMETRY_STOP(name, t)                                                \
+  do {                                                                         \
+  } while (0)
+
+#endif
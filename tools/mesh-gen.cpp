@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <omp.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+/*
+  Synthetic workloads for scaling tests, written as OFF.
+
+  Every generator computes any vertex or face from its index alone, and all
+  randomness comes from a counter-based hash of (seed, index), so the output
+  is byte-for-byte identical for a given seed regardless of the number of
+  threads. Blocks of elements are formatted in parallel and written in order.
+*/
+
+/******************************************************************************/
+/* Counter-based random numbers */
+
+static uint64_t mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/* Uniform in [-1, 1), a pure function of its arguments */
+static double uniform(uint64_t seed, uint64_t index, uint64_t stream = 0) {
+  uint64_t r = mix(mix(seed ^ (stream * 0xd1b54a32d192ed03ULL)) + index);
+  return (r >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+/******************************************************************************/
+
+class Generator {
+public:
+  virtual ~Generator() {}
+  virtual int64_t getNoOfVertices() const = 0;
+  virtual int64_t getNoOfFaces() const = 0;
+  virtual void vertex(int64_t, double p[3]) const = 0;
+  virtual void face(int64_t, int64_t v[3]) const = 0;
+};
+
+/* Positions and triangles of a small OFF file */
+struct BaseMesh {
+  std::vector<double> vertices;
+  std::vector<int64_t> faces;
+
+  BaseMesh(const char *inputFile) {
+    FILE *file = fopen(inputFile, "r");
+    char buffer[256];
+    int nv, nf, ne;
+    if (!file || fscanf(file, "%255s", buffer) != 1 ||
+        strncmp("OFF", buffer, 3) ||
+        fscanf(file, "%d %d %d", &nv, &nf, &ne) != 3) {
+      std::cerr << std::endl
+                << "Error:  Unable to read " << inputFile << "." << std::endl;
+      exit(11);
+    }
+
+    this->vertices.resize(3 * nv);
+    for (int i = 0; i < 3 * nv; i++) {
+      if (fscanf(file, "%lf", &this->vertices[i]) != 1) {
+        std::cerr << std::endl
+                  << "Error:  Invalid vertices in " << inputFile << "."
+                  << std::endl;
+        exit(14);
+      }
+    }
+
+    for (int i = 0; i < nf; i++) {
+      int n;
+      int64_t v[3];
+      if (fscanf(file, "%d %ld %ld %ld", &n, &v[0], &v[1], &v[2]) != 4 ||
+          n != 3) {
+        std::cerr << std::endl
+                  << "Error:  Only triangle meshes are supported as input."
+                  << std::endl;
+        exit(15);
+      }
+      this->faces.insert(this->faces.end(), v, v + 3);
+    }
+
+    fclose(file);
+  }
+
+  int64_t getNoOfVertices() const { return this->vertices.size() / 3; }
+  int64_t getNoOfFaces() const { return this->faces.size() / 3; }
+};
+
+/******************************************************************************/
+
+/*
+  Every triangle of the base mesh is split into <frequency>^2 triangles and,
+  for a closed base such as the icosahedron in model.off, the result is
+  projected onto the circumscribed sphere. Vertices are numbered base
+  corners first, then the <frequency> - 1 points of every base edge, then the
+  interior points of every base face.
+*/
+class SubdividedMesh : public Generator {
+  BaseMesh base;
+  int64_t n;
+  bool sphere;
+  double noise;
+  uint64_t seed;
+
+  std::map<std::pair<int64_t, int64_t>, int64_t> edgeIds;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  double center[3];
+  double radius;
+
+  int64_t getEdgeOffset() const { return base.getNoOfVertices(); }
+  int64_t getInteriorOffset() const {
+    return getEdgeOffset() + (int64_t)edges.size() * (n - 1);
+  }
+  int64_t getNoOfInteriorVertices() const { return (n - 1) * (n - 2) / 2; }
+
+  /* Interior points before row i (1-based) of a face */
+  int64_t rowOffset(int64_t i) const {
+    return (i - 1) * (n - 1) - (i - 1) * i / 2;
+  }
+
+  /* Point t steps from base vertex p towards q, with 0 < t < n */
+  int64_t edgeVertex(int64_t p, int64_t q, int64_t t) const {
+    int64_t e =
+        this->edgeIds.at(std::make_pair(std::min(p, q), std::max(p, q)));
+    int64_t s = p < q ? t : n - t;
+    return getEdgeOffset() + e * (n - 1) + s - 1;
+  }
+
+  /* Global id of the point i steps towards corner 1 and j towards corner 2 */
+  int64_t id(int64_t f, int64_t i, int64_t j) const {
+    const int64_t *c = &this->base.faces[3 * f];
+    int64_t a = n - i - j;
+    if (!i && !j) {
+      return c[0];
+    } else if (!a && !j) {
+      return c[1];
+    } else if (!a && !i) {
+      return c[2];
+    } else if (!j) {
+      return edgeVertex(c[0], c[1], i);
+    } else if (!a) {
+      return edgeVertex(c[1], c[2], j);
+    } else if (!i) {
+      return edgeVertex(c[0], c[2], j);
+    }
+    return getInteriorOffset() + f * getNoOfInteriorVertices() + rowOffset(i) +
+           j - 1;
+  }
+
+  void corner(int64_t v, double p[3]) const {
+    for (int k = 0; k < 3; k++) {
+      p[k] = this->base.vertices[3 * v + k];
+    }
+  }
+
+public:
+  SubdividedMesh(const char *inputFile, int64_t frequency, bool sphere,
+                 double noise, uint64_t seed)
+      : base(inputFile), n(std::max<int64_t>(frequency, 1)), sphere(sphere),
+        noise(noise), seed(seed) {
+    for (int64_t f = 0; f < base.getNoOfFaces(); f++) {
+      for (int k = 0; k < 3; k++) {
+        int64_t p = base.faces[3 * f + k];
+        int64_t q = base.faces[3 * f + (k + 1) % 3];
+        auto key = std::make_pair(std::min(p, q), std::max(p, q));
+        if (!this->edgeIds.count(key)) {
+          this->edgeIds[key] = this->edges.size();
+          this->edges.push_back(key);
+        }
+      }
+    }
+
+    this->center[0] = this->center[1] = this->center[2] = 0.0;
+    for (int64_t v = 0; v < base.getNoOfVertices(); v++) {
+      for (int k = 0; k < 3; k++) {
+        this->center[k] += base.vertices[3 * v + k] / base.getNoOfVertices();
+      }
+    }
+    this->radius = 0.0;
+    for (int64_t v = 0; v < base.getNoOfVertices(); v++) {
+      double d[3];
+      corner(v, d);
+      this->radius += sqrt(pow(d[0] - center[0], 2) +
+                           pow(d[1] - center[1], 2) +
+                           pow(d[2] - center[2], 2)) /
+                      base.getNoOfVertices();
+    }
+  }
+
+  int64_t getNoOfVertices() const {
+    return getInteriorOffset() +
+           base.getNoOfFaces() * getNoOfInteriorVertices();
+  }
+
+  int64_t getNoOfFaces() const { return base.getNoOfFaces() * n * n; }
+
+  void vertex(int64_t v, double p[3]) const {
+    if (v < getEdgeOffset()) {
+      corner(v, p);
+    } else if (v < getInteriorOffset()) {
+      int64_t e = (v - getEdgeOffset()) / (n - 1);
+      int64_t t = (v - getEdgeOffset()) % (n - 1) + 1;
+      double a[3], b[3];
+      corner(this->edges[e].first, a);
+      corner(this->edges[e].second, b);
+      for (int k = 0; k < 3; k++) {
+        p[k] = a[k] + (b[k] - a[k]) * t / n;
+      }
+    } else {
+      int64_t f = (v - getInteriorOffset()) / getNoOfInteriorVertices();
+      int64_t r = (v - getInteriorOffset()) % getNoOfInteriorVertices();
+      int64_t lo = 1, hi = n - 2;
+      while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        if (rowOffset(mid) <= r) {
+          lo = mid;
+        } else {
+          hi = mid - 1;
+        }
+      }
+      int64_t i = lo, j = r - rowOffset(lo) + 1;
+      double c[3][3];
+      for (int k = 0; k < 3; k++) {
+        corner(this->base.faces[3 * f + k], c[k]);
+      }
+      for (int k = 0; k < 3; k++) {
+        p[k] = c[0][k] + (c[1][k] - c[0][k]) * i / n +
+               (c[2][k] - c[0][k]) * j / n;
+      }
+    }
+
+    if (this->sphere) {
+      double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+      double length = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+      double scale = this->radius / length *
+                     (1.0 + this->noise * uniform(this->seed, v));
+      for (int k = 0; k < 3; k++) {
+        p[k] = center[k] + d[k] * scale;
+      }
+    }
+  }
+
+  /*
+    Row i of a face holds n - i upward and n - i - 1 downward triangles,
+    interleaved, so row i starts at triangle i (2n - i).
+  */
+  void face(int64_t index, int64_t v[3]) const {
+    int64_t f = index / (n * n);
+    int64_t k = index % (n * n);
+    int64_t i = n - (int64_t)sqrt((double)(n * n - k));
+    while (i > 0 && i * (2 * n - i) > k) {
+      i--;
+    }
+    while ((i + 1) * (2 * n - i - 1) <= k) {
+      i++;
+    }
+    int64_t r = k - i * (2 * n - i);
+    int64_t j = r / 2;
+    if (r % 2 == 0) {
+      v[0] = id(f, i, j);
+      v[1] = id(f, i + 1, j);
+      v[2] = id(f, i, j + 1);
+    } else {
+      v[0] = id(f, i + 1, j);
+      v[1] = id(f, i + 1, j + 1);
+      v[2] = id(f, i, j + 1);
+    }
+  }
+};
+
+/******************************************************************************/
+
+/* Smooth terrain on the unit square with per-vertex noise */
+static double height(double x, double y) {
+  return 0.05 * sin(6.0 * M_PI * x) * sin(4.0 * M_PI * y) +
+         0.02 * sin(17.0 * M_PI * (x + y));
+}
+
+/* <size> x <size> vertices, two triangles per cell */
+class HeightField : public Generator {
+  int64_t n;
+  double noise;
+  uint64_t seed;
+
+public:
+  HeightField(int64_t size, double noise, uint64_t seed)
+      : n(std::max<int64_t>(size, 2)), noise(noise), seed(seed) {}
+
+  int64_t getNoOfVertices() const { return n * n; }
+  int64_t getNoOfFaces() const { return 2 * (n - 1) * (n - 1); }
+
+  void vertex(int64_t v, double p[3]) const {
+    p[0] = (double)(v % n) / (n - 1);
+    p[1] = (double)(v / n) / (n - 1);
+    p[2] = height(p[0], p[1]) + this->noise * uniform(this->seed, v);
+  }
+
+  void face(int64_t index, int64_t v[3]) const {
+    int64_t c = index / 2;
+    int64_t base = (c / (n - 1)) * n + c % (n - 1);
+    if (index % 2 == 0) {
+      v[0] = base, v[1] = base + 1, v[2] = base + n + 1;
+    } else {
+      v[0] = base, v[1] = base + n + 1, v[2] = base + n;
+    }
+  }
+};
+
+/*
+  <copies> disconnected copies of an input mesh on a cubic lattice, each
+  shifted by a random fraction of the lattice spacing.
+*/
+class TiledMesh : public Generator {
+  BaseMesh base;
+  int64_t copies;
+  int64_t side;
+  double spacing[3];
+  uint64_t seed;
+
+public:
+  TiledMesh(const char *inputFile, int64_t copies, uint64_t seed)
+      : base(inputFile), copies(std::max<int64_t>(copies, 1)), seed(seed) {
+    this->side = 1;
+    while (this->side * this->side * this->side < this->copies) {
+      this->side++;
+    }
+
+    for (int k = 0; k < 3; k++) {
+      double lo = DBL_MAX, hi = -DBL_MAX;
+      for (int64_t v = 0; v < base.getNoOfVertices(); v++) {
+        lo = std::min(lo, base.vertices[3 * v + k]);
+        hi = std::max(hi, base.vertices[3 * v + k]);
+      }
+      this->spacing[k] = 1.5 * (hi - lo);
+    }
+  }
+
+  int64_t getNoOfVertices() const { return copies * base.getNoOfVertices(); }
+  int64_t getNoOfFaces() const { return copies * base.getNoOfFaces(); }
+
+  void vertex(int64_t v, double p[3]) const {
+    int64_t t = v / base.getNoOfVertices();
+    int64_t tile[3] = {t % side, (t / side) % side, t / (side * side)};
+    for (int k = 0; k < 3; k++) {
+      double shift = 0.1 * uniform(this->seed, t, k + 1);
+      p[k] = base.vertices[3 * (v % base.getNoOfVertices()) + k] +
+             (tile[k] + shift) * this->spacing[k];
+    }
+  }
+
+  void face(int64_t index, int64_t v[3]) const {
+    int64_t t = index / base.getNoOfFaces();
+    for (int k = 0; k < 3; k++) {
+      v[k] = base.faces[3 * (index % base.getNoOfFaces()) + k] +
+             t * base.getNoOfVertices();
+    }
+  }
+};
+
+/*
+  Height field whose cells are grouped into <hub> x <hub> blocks. A random
+  <fraction> of the blocks is triangulated as a fan around an extra centre
+  vertex of valence 4 <hub>; the others keep the regular valence-6 pattern.
+  Grid points inside fan blocks are dropped, so grid vertices are numbered
+  row by row over the points that remain, followed by the hub vertices in
+  block order.
+*/
+class SkewedMesh : public Generator {
+  int64_t n;
+  int64_t hub;
+  int64_t blocks; // per side
+  double noise;
+  uint64_t seed;
+
+  std::vector<int64_t> faceOffsets; // first face of every block, plus total
+  std::vector<int64_t> hubIds;      // -1 for regular blocks
+  std::vector<int64_t> hubBlocks;   // block of every hub vertex
+  std::vector<int64_t> skipped;     // dropped points left of each block column
+  std::vector<int64_t> rowOffsets;  // first vertex of every row, plus total
+
+  int64_t getSkipped(int64_t y, int64_t column) const {
+    return y % hub ? skipped[(y / hub) * (blocks + 1) + column] : 0;
+  }
+
+  /* Vertex id of grid point (x, y) */
+  int64_t id(int64_t x, int64_t y) const {
+    return rowOffsets[y] + x - getSkipped(y, x / hub);
+  }
+
+  /* Vertex k of the boundary of block b, counter-clockwise */
+  int64_t ring(int64_t b, int64_t k) const {
+    int64_t x0 = (b % blocks) * hub, y0 = (b / blocks) * hub;
+    int64_t side = k / hub, s = k % hub;
+    if (side == 0) {
+      return id(x0 + s, y0);
+    } else if (side == 1) {
+      return id(x0 + hub, y0 + s);
+    } else if (side == 2) {
+      return id(x0 + hub - s, y0 + hub);
+    }
+    return id(x0, y0 + hub - s);
+  }
+
+public:
+  SkewedMesh(int64_t size, int64_t hub, double fraction, double noise,
+             uint64_t seed)
+      : hub(std::max<int64_t>(hub, 1)), noise(noise), seed(seed) {
+    this->blocks = std::max<int64_t>((size - 1) / this->hub, 1);
+    this->n = this->blocks * this->hub + 1;
+
+    int64_t faces = 0;
+    for (int64_t b = 0; b < this->blocks * this->blocks; b++) {
+      this->faceOffsets.push_back(faces);
+      bool fan = (uniform(seed, b, 7) + 1.0) / 2.0 < fraction;
+      this->hubIds.push_back(fan ? (int64_t)this->hubBlocks.size() : -1);
+      if (fan) {
+        this->hubBlocks.push_back(b);
+      }
+      faces += fan ? 4 * this->hub : 2 * this->hub * this->hub;
+    }
+    this->faceOffsets.push_back(faces);
+
+    for (int64_t by = 0; by < this->blocks; by++) {
+      int64_t count = 0;
+      for (int64_t bx = 0; bx <= this->blocks; bx++) {
+        this->skipped.push_back(count);
+        if (bx < this->blocks && this->hubIds[by * this->blocks + bx] >= 0) {
+          count += this->hub - 1;
+        }
+      }
+    }
+
+    int64_t vertices = 0;
+    for (int64_t y = 0; y < this->n; y++) {
+      this->rowOffsets.push_back(vertices);
+      vertices += this->n - getSkipped(y, this->blocks);
+    }
+    this->rowOffsets.push_back(vertices);
+
+    for (int64_t &h : this->hubIds) {
+      h = h >= 0 ? vertices + h : -1;
+    }
+  }
+
+  int64_t getNoOfVertices() const {
+    return rowOffsets.back() + hubBlocks.size();
+  }
+
+  int64_t getNoOfFaces() const { return faceOffsets.back(); }
+
+  void vertex(int64_t v, double p[3]) const {
+    if (v < rowOffsets.back()) {
+      int64_t y = std::upper_bound(rowOffsets.begin(), rowOffsets.end(), v) -
+                  rowOffsets.begin() - 1;
+      int64_t r = v - rowOffsets[y];
+
+      // Last block column whose left edge is at or before r, then step in
+      int64_t lo = 0, hi = blocks;
+      while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        if (mid * hub - getSkipped(y, mid) <= r) {
+          lo = mid;
+        } else {
+          hi = mid - 1;
+        }
+      }
+      int64_t x = lo * hub + r - (lo * hub - getSkipped(y, lo));
+
+      p[0] = (double)x / (n - 1);
+      p[1] = (double)y / (n - 1);
+    } else {
+      int64_t b = this->hubBlocks[v - rowOffsets.back()];
+      p[0] = ((b % blocks) * hub + 0.5 * hub) / (n - 1);
+      p[1] = ((b / blocks) * hub + 0.5 * hub) / (n - 1);
+    }
+    p[2] = height(p[0], p[1]) + this->noise * uniform(this->seed, v);
+  }
+
+  void face(int64_t index, int64_t v[3]) const {
+    int64_t b = std::upper_bound(faceOffsets.begin(), faceOffsets.end(),
+                                 index) -
+                faceOffsets.begin() - 1;
+    int64_t k = index - faceOffsets[b];
+    if (hubIds[b] >= 0) {
+      v[0] = hubIds[b];
+      v[1] = ring(b, k);
+      v[2] = ring(b, (k + 1) % (4 * hub));
+    } else {
+      int64_t c = k / 2;
+      int64_t x = (b % blocks) * hub + c % hub;
+      int64_t y = (b / blocks) * hub + c / hub;
+      if (k % 2 == 0) {
+        v[0] = id(x, y), v[1] = id(x + 1, y), v[2] = id(x + 1, y + 1);
+      } else {
+        v[0] = id(x, y), v[1] = id(x + 1, y + 1), v[2] = id(x, y + 1);
+      }
+    }
+  }
+};
+
+/******************************************************************************/
+
+/*
+  Format blocks of lines in parallel and append them to the file in order, a
+  bounded number of blocks at a time.
+*/
+static void write(const Generator &generator, const char *outputFile,
+                  int noOfThreads) {
+  FILE *file = fopen(outputFile, "w");
+  if (!file) {
+    std::cerr << std::endl
+              << "Error:  Unable to "
+                 "create output file."
+              << std::endl;
+    exit(16);
+  }
+
+  int64_t noOfVertices = generator.getNoOfVertices();
+  int64_t noOfFaces = generator.getNoOfFaces();
+  fprintf(file, "OFF\n");
+  fprintf(file, "%ld %ld %d\n", noOfVertices, noOfFaces, 0);
+
+  const int64_t blockSize = 1 << 16;
+  int64_t noOfLines = noOfVertices + noOfFaces;
+  int64_t noOfBlocks = (noOfLines + blockSize - 1) / blockSize;
+  int batch = 4 * noOfThreads;
+  std::vector<std::string> buffers(batch);
+
+  omp_set_num_threads(noOfThreads);
+  for (int64_t first = 0; first < noOfBlocks; first += batch) {
+    int count = std::min<int64_t>(batch, noOfBlocks - first);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < count; b++) {
+      std::string &buffer = buffers[b];
+      buffer.clear();
+      char line[128];
+      int64_t end = std::min(noOfLines, (first + b + 1) * blockSize);
+      for (int64_t i = (first + b) * blockSize; i < end; i++) {
+        int length;
+        if (i < noOfVertices) {
+          double p[3];
+          generator.vertex(i, p);
+          length = snprintf(line, sizeof(line), "%lf %lf %lf\n", p[0], p[1],
+                            p[2]);
+        } else {
+          int64_t v[3];
+          generator.face(i - noOfVertices, v);
+          length = snprintf(line, sizeof(line), "%d %ld %ld %ld\n", 3, v[0],
+                            v[1], v[2]);
+        }
+        buffer.append(line, length);
+      }
+    }
+
+    for (int b = 0; b < count; b++) {
+      fwrite(buffers[b].data(), 1, buffers[b].size(), file);
+    }
+  }
+
+  if (fclose(file)) {
+    std::cerr << std::endl
+              << "Error:  Unable to "
+                 "write output file."
+              << std::endl;
+    exit(16);
+  }
+}
+
+static void usage() {
+  std::cerr
+      << std::endl
+      << "Usage:  ./mesh-gen <kind> <output file> [options]\n"
+      << std::endl
+      << "Kinds:" << std::endl
+      << "  icosphere   Subdivided --input (default model.off), projected "
+         "onto a sphere"
+      << std::endl
+      << "  grid        Noisy height field" << std::endl
+      << "  tiles       Disconnected copies of --input (default bunny.off)"
+      << std::endl
+      << "  skew        Height field with fan blocks of valence 4 x --hub"
+      << std::endl
+      << std::endl
+      << "Options:" << std::endl
+      << "  --triangles <n>   Approximate number of triangles (default 1M)"
+      << std::endl
+      << "  --input <file>    Base mesh for icosphere and tiles" << std::endl
+      << "  --noise <a>       Noise amplitude (default 0.001)" << std::endl
+      << "  --hub <h>         Fan block size in cells for skew (default 8)"
+      << std::endl
+      << "  --fraction <f>    Share of fan blocks for skew (default 0.25)"
+      << std::endl
+      << "  --seed <s>        Random seed (default 1)" << std::endl
+      << "  --threads <t>     Number of threads (default all)" << std::endl
+      << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    usage();
+    exit(1);
+  }
+
+  const char *kind = argv[1];
+  const char *outputFile = argv[2];
+  double triangles = 1e6;
+  const char *inputFile = NULL;
+  double noise = 0.001;
+  int64_t hub = 8;
+  double fraction = 0.25;
+  uint64_t seed = 1;
+  int noOfThreads = omp_get_max_threads();
+  for (int i = 3; i < argc; i++) {
+    if (!strcmp(argv[i], "--triangles") && i + 1 < argc) {
+      triangles = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--input") && i + 1 < argc) {
+      inputFile = argv[++i];
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--hub") && i + 1 < argc) {
+      hub = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--fraction") && i + 1 < argc) {
+      fraction = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      noOfThreads = std::max(atoi(argv[++i]), 1);
+    } else {
+      usage();
+      exit(3);
+    }
+  }
+
+  Generator *generator = NULL;
+  if (!strcmp(kind, "icosphere")) {
+    BaseMesh base(inputFile ? inputFile : "model.off");
+    int64_t frequency = llround(sqrt(triangles / base.getNoOfFaces()));
+    generator = new SubdividedMesh(inputFile ? inputFile : "model.off",
+                                   frequency, true, noise, seed);
+  } else if (!strcmp(kind, "grid")) {
+    generator = new HeightField(llround(sqrt(triangles / 2)) + 1, noise, seed);
+  } else if (!strcmp(kind, "tiles")) {
+    BaseMesh base(inputFile ? inputFile : "bunny.off");
+    int64_t copies = llround(triangles / base.getNoOfFaces());
+    generator =
+        new TiledMesh(inputFile ? inputFile : "bunny.off", copies, seed);
+  } else if (!strcmp(kind, "skew")) {
+    // Fan blocks hold fewer triangles than regular ones
+    double perCell = 2.0 * (1.0 - fraction) + 4.0 * fraction / hub;
+    generator = new SkewedMesh(llround(sqrt(triangles / perCell)) + 1, hub,
+                               fraction, noise, seed);
+  } else {
+    usage();
+    exit(2);
+  }
+
+  std::cout << "Generating " << kind << " [" << generator->getNoOfVertices()
+            << " vertex(s), " << generator->getNoOfFaces() << " face(s)]... "
+            << std::flush;
+
+  timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  write(*generator, outputFile, noOfThreads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+  std::cout << "Done" << std::endl;
+  std::cout << "Generation Time     : " << ms << " ms (" << noOfThreads
+            << " thread(s))" << std::endl;
+
+  delete generator;
+  return 0;
+}
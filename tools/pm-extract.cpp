@@ -0,0 +1,48 @@
+#include <cstring>
+#include <iostream>
+#include <time.h>
+
+#include "../pm.h"
+
+/*
+  Extract one level of detail from a progressive mesh log written by
+  `mesh-simplification ... --pm <log>`.
+*/
+int main(int argc, char **argv) {
+  if (argc < 5) {
+    std::cerr << std::endl
+              << "Usage:  ./pm-extract <log file> <output file> "
+                 "--vertices <count> | --faces <count> | --fraction "
+                 "<simplification fraction>\n"
+              << std::endl;
+    exit(1);
+  }
+
+  timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  ProgressiveMeshExtractor extractor(argv[1]);
+  if (!strcmp(argv[3], "--vertices")) {
+    extractor.extractVertices(atoi(argv[4]), argv[2]);
+  } else if (!strcmp(argv[3], "--faces")) {
+    extractor.extractFaces(atoi(argv[4]), argv[2]);
+  } else if (!strcmp(argv[3], "--fraction")) {
+    int noOfVertices = extractor.getNoOfVertices();
+    extractor.extractVertices(noOfVertices - atof(argv[4]) * noOfVertices,
+                              argv[2]);
+  } else {
+    std::cerr << std::endl
+              << "Error:  Unknown target " << argv[3] << ".\n"
+              << std::endl;
+    exit(2);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+  std::cout << "Log Size            : " << extractor.getSize() / 1024 << " KB ("
+            << extractor.getNoOfCollapses() << " collapse(s))" << std::endl;
+  std::cout << "Extraction Time     : " << ms << " ms" << std::endl;
+
+  return 0;
+}
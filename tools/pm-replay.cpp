@@ -0,0 +1,269 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../mesh.h"
+#include "../pm.h"
+
+/*
+  Replay the collapses of a progressive mesh log, written by
+  `mesh-simplification ... --pm <log>`, on connectivity backends. Every
+  backend applies the same collapses in the order the run applied them,
+  without computing costs or scheduling anything, so the replay time is the
+  cost of the data structure alone.
+*/
+
+static double now() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/******************************************************************************/
+
+class ReplayBackend {
+public:
+  virtual ~ReplayBackend() {}
+
+  /* Build the input mesh of the log */
+  virtual void load(const ProgressiveMeshExtractor &) = 0;
+
+  /* Merge vertex v1 into v2, which moves to (x, y, z) */
+  virtual bool collapse(int v1, int v2, double x, double y, double z) = 0;
+
+  virtual int getNoOfFaces() const = 0;
+};
+
+/******************************************************************************/
+
+/*
+  Mesh, the adjacency lists the simplifier runs on. Mesh::readEdges orients
+  edges by vertex address, so an edge of the log can come out reversed here;
+  it is then collapsed the other way round and the surviving vertex stands in
+  for v2 from then on.
+*/
+class MeshBackend : public ReplayBackend {
+  std::unique_ptr<Mesh> mesh;
+  std::vector<Vertex *> vertices; // by log id
+  std::vector<Face *> removedFaces;
+
+public:
+  void load(const ProgressiveMeshExtractor &extractor) override {
+    // Through OFF, so vertex and face ids are those of the logged run
+    char path[] = "/tmp/pm-replay-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+      std::cerr << std::endl
+                << "Error:  Unable to create temporary mesh file." << std::endl;
+      exit(16);
+    }
+    close(fd);
+    extractor.extractVertices(extractor.getNoOfVertices(), path);
+    this->mesh.reset(new Mesh(path));
+    unlink(path);
+    this->vertices = this->mesh->getVertices();
+  }
+
+  bool collapse(int v1, int v2, double x, double y, double z) override {
+    Vertex *from = this->vertices[v1];
+    Vertex *to = this->vertices[v2];
+    Scalar placement[3] = {(Scalar)x, (Scalar)y, (Scalar)z};
+    this->removedFaces.clear();
+
+    for (Edge *e : from->getOutgoingEdges()) {
+      if (e->getV2() == to) {
+        return Mesh::collapseEdge(e, placement, this->removedFaces);
+      }
+    }
+    for (Edge *e : from->getIncomingEdges()) {
+      if (e->getV1() == to) {
+        this->vertices[v2] = from;
+        return Mesh::collapseEdge(e, placement, this->removedFaces);
+      }
+    }
+    return false;
+  }
+
+  int getNoOfFaces() const override {
+    int count = 0;
+    for (const Face *f : this->mesh->getFaces()) {
+      if (!f->isRemoved()) {
+        count++;
+      }
+    }
+    return count;
+  }
+};
+
+/******************************************************************************/
+
+/*
+  Structure of arrays: three vertex ids per face and the face ids around every
+  vertex, with removed faces dropped from the lists they are in.
+*/
+class ArrayBackend : public ReplayBackend {
+  std::vector<double> positions;
+  std::vector<int32_t> faceVertices;
+  std::vector<char> faceRemoved;
+  std::vector<char> vertexRemoved;
+  std::vector<std::vector<int32_t>> vertexFaces;
+  std::vector<int32_t> removedFaces;
+  int noOfFaces;
+
+  void dropRemovedFaces(int v) {
+    std::vector<int32_t> &faces = this->vertexFaces[v];
+    int n = 0;
+    for (int32_t f : faces) {
+      if (!this->faceRemoved[f]) {
+        faces[n++] = f;
+      }
+    }
+    faces.resize(n);
+  }
+
+public:
+  void load(const ProgressiveMeshExtractor &extractor) override {
+    int noOfVertices = extractor.getNoOfVertices();
+    this->noOfFaces = extractor.getNoOfFaces();
+    this->positions.assign(extractor.getVertices(),
+                           extractor.getVertices() + 3 * noOfVertices);
+    this->faceVertices.assign(extractor.getFaces(),
+                              extractor.getFaces() + 3 * this->noOfFaces);
+    this->faceRemoved.assign(this->noOfFaces, 0);
+    this->vertexRemoved.assign(noOfVertices, 0);
+    this->vertexFaces.assign(noOfVertices, std::vector<int32_t>());
+    for (int f = 0; f < this->noOfFaces; f++) {
+      for (int i = 0; i < 3; i++) {
+        this->vertexFaces[this->faceVertices[3 * f + i]].push_back(f);
+      }
+    }
+  }
+
+  bool collapse(int v1, int v2, double x, double y, double z) override {
+    if (this->vertexRemoved[v1] || this->vertexRemoved[v2] ||
+        this->vertexFaces[v1].empty() || this->vertexFaces[v2].empty()) {
+      return false;
+    }
+
+    this->removedFaces.clear();
+    for (int32_t f : this->vertexFaces[v1]) {
+      int32_t *fv = &this->faceVertices[3 * f];
+      if (fv[0] == v2 || fv[1] == v2 || fv[2] == v2) {
+        this->faceRemoved[f] = 1;
+        this->removedFaces.push_back(f);
+        continue;
+      }
+      for (int i = 0; i < 3; i++) {
+        if (fv[i] == v1) {
+          fv[i] = v2;
+        }
+      }
+      this->vertexFaces[v2].push_back(f);
+    }
+    this->noOfFaces -= this->removedFaces.size();
+
+    for (int32_t f : this->removedFaces) {
+      for (int i = 0; i < 3; i++) {
+        int v = this->faceVertices[3 * f + i];
+        if (v != v1) {
+          this->dropRemovedFaces(v);
+        }
+      }
+    }
+    this->vertexFaces[v1].clear();
+    this->vertexRemoved[v1] = 1;
+
+    this->positions[3 * v2] = x;
+    this->positions[3 * v2 + 1] = y;
+    this->positions[3 * v2 + 2] = z;
+    return true;
+  }
+
+  int getNoOfFaces() const override { return this->noOfFaces; }
+};
+
+/******************************************************************************/
+
+static ReplayBackend *createBackend(const std::string &name) {
+  if (name == "mesh") {
+    return new MeshBackend();
+  }
+  if (name == "arrays") {
+    return new ArrayBackend();
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << std::endl
+              << "Usage:  ./pm-replay <log file> [mesh | arrays]...\n"
+              << std::endl;
+    exit(1);
+  }
+
+  std::vector<std::string> backends(argv + 2, argv + argc);
+  if (backends.empty()) {
+    backends = {"mesh", "arrays"};
+  }
+
+  ProgressiveMeshExtractor extractor(argv[1]);
+  const ProgressiveMesh::Record *records = extractor.getRecords();
+
+  // Faces left once the whole log is applied, to check every backend against
+  int expectedFaces = extractor.getNoOfFaces();
+  for (int i = 0; i < extractor.getNoOfRecords(); i++) {
+    expectedFaces -= (records[i].f1 >= 0) + (records[i].f2 >= 0);
+  }
+
+  std::cout << "Log                 : " << extractor.getNoOfVertices()
+            << " vertex(s), " << extractor.getNoOfFaces() << " face(s), "
+            << extractor.getNoOfCollapses() << " collapse(s)" << std::endl;
+
+  for (const std::string &name : backends) {
+    std::unique_ptr<ReplayBackend> backend(createBackend(name));
+    if (!backend) {
+      std::cerr << std::endl
+                << "Error:  Unknown backend " << name << ".\n"
+                << std::endl;
+      exit(2);
+    }
+
+    double t0 = now();
+    backend->load(extractor);
+    double t1 = now();
+    int collapses = 0;
+    for (int i = 0; i < extractor.getNoOfRecords(); i++) {
+      const ProgressiveMesh::Record &r = records[i];
+      if (r.v1 >= 0) {
+        collapses += backend->collapse(r.v1, r.v2, r.x, r.y, r.z);
+      }
+    }
+    double t2 = now();
+
+    std::cout << std::endl;
+    std::cout << "Backend             : " << name << std::endl;
+    std::cout << "Load Time           : " << t1 - t0 << " ms" << std::endl;
+    std::cout << "Replay Time         : " << t2 - t1 << " ms" << std::endl;
+    std::cout << "Collapses/s         : " << collapses / ((t2 - t1) / 1e3)
+              << std::endl;
+
+    if (collapses != extractor.getNoOfCollapses() ||
+        backend->getNoOfFaces() != expectedFaces) {
+      std::cerr << std::endl
+                << "Error:  Replay diverged from the log: " << collapses
+                << " of " << extractor.getNoOfCollapses()
+                << " collapse(s) applied, " << backend->getNoOfFaces()
+                << " face(s) left instead of " << expectedFaces << "."
+                << std::endl;
+      exit(23);
+    }
+  }
+
+  return 0;
+}
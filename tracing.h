@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <time.h>
+#include <vector>
+
+/*
+  Event tracing for parallel timelines, off unless enabled at run time.
+
+  Every thread records complete events (name, begin, end and an optional
+  integer argument) into its own ring buffer, so recording takes no lock; once
+  a buffer is full the oldest events are overwritten. While tracing is off a
+  TraceScope costs one relaxed atomic load.
+
+  Tracer::get().save() writes the buffers in the Chrome trace event format,
+  which chrome://tracing and ui.perfetto.dev open directly. Buffers are read
+  without synchronization, so save only once the recording threads are done.
+*/
+class Tracer {
+public:
+  struct Event {
+    const char *name; // string literal
+    long long begin;  // nanoseconds
+    long long end;
+    long long arg; // -1 for none
+  };
+
+private:
+  struct Buffer {
+    int tid;
+    std::vector<Event> events;
+    unsigned long long next; // events ever recorded
+  };
+
+  std::atomic<bool> enabled;
+  size_t capacity;
+  long long origin;
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+
+  Tracer() : enabled(false), capacity(0), origin(now()) {}
+  Tracer(const Tracer &) = delete;
+
+  Buffer *allocateBuffer() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Buffer *buffer = new Buffer();
+    buffer->tid = this->buffers.size();
+    buffer->events.resize(this->capacity);
+    buffer->next = 0;
+    this->buffers.emplace_back(buffer);
+    return buffer;
+  }
+
+  /* Ring buffer of the calling thread, allocated on its first event */
+  static Buffer *local() {
+    thread_local Buffer *buffer = get().allocateBuffer();
+    return buffer;
+  }
+
+public:
+  static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+  /* Monotonic time in nanoseconds */
+  static long long now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+  }
+
+  static Tracer &get() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  /*
+    Start recording with <capacity> events per thread. Call once, before any
+    thread records.
+  */
+  void enable(size_t capacity = DEFAULT_CAPACITY) {
+    this->capacity = capacity > 0 ? capacity : 1;
+    this->origin = now();
+    this->enabled.store(true, std::memory_order_relaxed);
+  }
+
+  bool isEnabled() const {
+    return this->enabled.load(std::memory_order_relaxed);
+  }
+
+  void record(const char *name, long long begin, long long end,
+              long long arg = -1) {
+    Buffer *buffer = local();
+    Event &event = buffer->events[buffer->next++ % this->capacity];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.arg = arg;
+  }
+
+  bool save(const char *jsonFile) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    FILE *file = fopen(jsonFile, "w");
+    if (!file) {
+      return false;
+    }
+
+    unsigned long long dropped = 0;
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (int b = 0; b < (int)this->buffers.size(); b++) {
+      const Buffer &buffer = *this->buffers[b];
+      fprintf(file,
+              "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+              "\"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+              b ? ",\n" : "", buffer.tid, buffer.tid);
+
+      unsigned long long first = 0;
+      if (buffer.next > this->capacity) {
+        first = buffer.next - this->capacity;
+        dropped += first;
+      }
+      for (unsigned long long i = first; i < buffer.next; i++) {
+        const Event &e = buffer.events[i % this->capacity];
+        fprintf(file,
+                ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, "
+                "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                e.name, buffer.tid, (e.begin - this->origin) / 1e3,
+                (e.end - e.begin) / 1e3);
+        if (e.arg >= 0) {
+          fprintf(file, ", \"args\": {\"arg\": %lld}", e.arg);
+        }
+        fprintf(file, "}");
+      }
+    }
+    fprintf(file, "\n], \"otherData\": {\"dropped_events\": %llu}}\n",
+            dropped);
+
+    return fclose(file) == 0;
+  }
+};
+
+/* Records the enclosing scope as one event of the calling thread */
+class TraceScope {
+  const char *name;
+  long long arg;
+  long long t0;
+
+public:
+  TraceScope(const char *name, long long arg = -1)
+      : name(name), arg(arg),
+        t0(Tracer::get().isEnabled() ? Tracer::now() : -1) {}
+  TraceScope(const TraceScope &) = delete;
+  ~TraceScope() { this->stop(); }
+
+  /* End the event before the scope does */
+  void stop() {
+    if (this->t0 >= 0) {
+      Tracer::get().record(this->name, this->t0, Tracer::now(), this->arg);
+      this->t0 = -1;
+    }
+  }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/* Trace the rest of the scope as event <name>, optionally with <arg> */
+#define TRACE_SCOPE(...)                                                       \
+  TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
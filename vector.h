@@ -1,19 +1,59 @@
 #pragma once
 
-class Vector {
-  double x;
-  double y;
-  double z;
-
-public:
-  Vector() = delete;
-  Vector(const double, const double, const double);
-
-  double getX() const;
-  double getY() const;
-  double getZ() const;
-  void update(const double, const double, const double);
-
-  void normalize();
-  Vector *cross(const Vector *v) const;
-};
\ No newline at end of file
+#include <cmath>
+
+/*
+  Value-type vectors of doubles for the geometry of both engines. Plain
+  aggregates with inline operations: nothing allocates, everything but
+  normalize() and length() (std::sqrt) is constexpr, and loops over them are
+  left to the compiler to vectorize.
+*/
+struct Vec3 {
+  double x, y, z;
+};
+
+struct Vec4 {
+  double x, y, z, w;
+};
+
+constexpr Vec3 operator+(const Vec3 &a, const Vec3 &b) {
+  return Vec3{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+constexpr Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return Vec3{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+constexpr Vec3 operator*(const Vec3 &a, double s) {
+  return Vec3{a.x * s, a.y * s, a.z * s};
+}
+
+constexpr Vec3 operator/(const Vec3 &a, double s) {
+  return Vec3{a.x / s, a.y / s, a.z / s};
+}
+
+constexpr double dot(const Vec3 &a, const Vec3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+constexpr Vec3 cross(const Vec3 &a, const Vec3 &b) {
+  return Vec3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+              a.x * b.y - a.y * b.x};
+}
+
+inline double length(const Vec3 &a) { return std::sqrt(dot(a, a)); }
+
+/* <a> scaled to unit length; a zero vector gives NaNs, as before */
+inline Vec3 normalize(const Vec3 &a) { return a / length(a); }
+
+constexpr double dot(const Vec4 &a, const Vec4 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+/* Plane through <point> with unit <normal>, as (a, b, c, d) of ax+by+cz+d=0 */
+constexpr Vec4 plane(const Vec3 &normal, const Vec3 &point) {
+  return Vec4{normal.x, normal.y, normal.z, -dot(normal, point)};
+}
+
+static_assert(cross(Vec3{1, 0, 0}, Vec3{0, 1, 0}).z == 1,
+              "right-handed cross product");